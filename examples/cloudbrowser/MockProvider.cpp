@@ -107,6 +107,11 @@ MockProvider::listDirectoryPageAsync(IItem::Pointer, const std::string&,
   return nullptr;
 }
 
+ICloudProvider::WalkTreeRequest::Pointer MockProvider::walkTreeAsync(
+    IItem::Pointer, IWalkTreeCallback::Pointer, uint32_t, uint32_t) {
+  return nullptr;
+}
+
 ICloudProvider::ListDirectoryRequest::Pointer MockProvider::listDirectoryAsync(
     IItem::Pointer, ListDirectoryCallback) {
   return nullptr;
@@ -172,6 +172,9 @@ class MockProvider : public ICloudProvider {
       IItem::Pointer, ListDirectoryCallback) override;
   ListDirectoryPageRequest::Pointer listDirectoryPageAsync(
       IItem::Pointer, const std::string&, ListDirectoryPageCallback) override;
+  WalkTreeRequest::Pointer walkTreeAsync(IItem::Pointer,
+                                         IWalkTreeCallback::Pointer, uint32_t,
+                                         uint32_t) override;
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer,
                                                  const std::string&,
                                                  DownloadFileCallback) override;
@@ -98,6 +98,7 @@ IItem::Pointer AmazonDrive::rootDirectory() const {
 ICloudProvider::MoveItemRequest::Pointer AmazonDrive::moveItemAsync(
     IItem::Pointer source, IItem::Pointer destination,
     MoveItemCallback callback) {
+  callback = invalidatePaths(source, destination, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
     move(r, http(), metadata_url(),
@@ -121,7 +122,7 @@ AuthorizeRequest::Pointer AmazonDrive::authorizeAsync() {
           auto input = std::make_shared<std::stringstream>(),
                output = std::make_shared<std::stringstream>(),
                error = std::make_shared<std::stringstream>();
-          r->send(request.get(),
+          r->send(request,
                   [=](IHttpRequest::Response response) {
                     (void)r;
                     if (!IHttpRequest::isSuccess(response.http_code_))
@@ -234,19 +235,22 @@ IItem::Pointer AmazonDrive::getItemDataResponse(std::istream& response) const {
 }
 
 std::vector<IItem::Pointer> AmazonDrive::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  Json::Value response;
-  stream >> response;
-
-  std::vector<IItem::Pointer> result;
-  for (const Json::Value& v : response["data"]) result.push_back(toItem(v));
-  if (response.isMember("nextToken"))
-    next_page_token = response["nextToken"].asString();
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
 
-  return result;
+CloudProvider::ListDirectoryParser::Pointer AmazonDrive::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "data", [=](const util::JsonView& v) { return toItem(v); }, received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        if (response.isMember("nextToken"))
+          next_page_token = response["nextToken"].asString();
+      });
 }
 
-IItem::FileType AmazonDrive::type(const Json::Value& v) const {
+IItem::FileType AmazonDrive::type(const util::JsonView& v) const {
   if (v["kind"].asString() == "FOLDER") return IItem::FileType::Directory;
   if (v["contentProperties"].isMember("image"))
     return IItem::FileType::Image;
@@ -256,7 +260,7 @@ IItem::FileType AmazonDrive::type(const Json::Value& v) const {
     return IItem::FileType::Unknown;
 }
 
-IItem::Pointer AmazonDrive::toItem(const Json::Value& v) const {
+IItem::Pointer AmazonDrive::toItem(const util::JsonView& v) const {
   std::string name = v["isRoot"].asBool() ? "root" : v["name"].asString();
   auto item = util::make_unique<Item>(name, v["id"].asString(),
                                       v["contentProperties"]["size"].asUInt64(),
@@ -265,12 +269,13 @@ IItem::Pointer AmazonDrive::toItem(const Json::Value& v) const {
   if (item->type() == IItem::FileType::Image)
     item->set_thumbnail_url(item->url() +
                             "?viewBox=" + std::to_string(THUMBNAIL_SIZE));
-  for (const Json::Value& asset : v["assets"])
+  for (const util::JsonView& asset : v["assets"].elements())
     if (type(asset) == IItem::FileType::Image)
       item->set_thumbnail_url(asset["tempLink"].asString() +
                               "?viewBox=" + std::to_string(THUMBNAIL_SIZE));
   std::vector<std::string> parents;
-  for (const Json::Value& p : v["parents"]) parents.push_back(p.asString());
+  for (const util::JsonView& p : v["parents"].elements())
+    parents.push_back(p.asString());
   item->set_parents(parents);
   return std::move(item);
 }
@@ -72,9 +72,11 @@ class AmazonDrive : public CloudProvider {
   IItem::Pointer getItemDataResponse(std::istream& response) const override;
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
 
-  IItem::FileType type(const Json::Value&) const;
-  IItem::Pointer toItem(const Json::Value&) const;
+  IItem::FileType type(const util::JsonView&) const;
+  IItem::Pointer toItem(const util::JsonView&) const;
 
   bool reauthorize(int code) const override;
 
@@ -23,9 +23,16 @@
 
 #include "AmazonS3.h"
 
+#include "Utility/XmlParser.h"
+
 #include <tinyxml2.h>
 #include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
 #include <iomanip>
+#include <map>
+#include <thread>
 
 using namespace std::placeholders;
 
@@ -33,9 +40,16 @@ namespace cloudstorage {
 
 namespace {
 
-void rename(Request<EitherError<void>>::Pointer r, IHttp* http,
-            std::string region, std::string dest_id, std::string source_id,
-            std::function<void(EitherError<void>)> complete);
+const uint64_t PART_SIZE = 16 * 1024 * 1024;
+const uint64_t MIN_PART_SIZE = 5 * 1024 * 1024;
+const uint64_t MAX_PARTS = 10000;
+const uint64_t PART_READ_SIZE = 1024 * 1024;
+const uint32_t UPLOAD_PARALLELISM = 4;
+const size_t MAX_DELETE_KEYS = 1000;
+const uint32_t DELETE_PARALLELISM = 4;
+const uint64_t MAX_COPY_SIZE = 5ull * 1024 * 1024 * 1024;
+const uint64_t COPY_PART_SIZE = 1024 * 1024 * 1024;
+const uint32_t COPY_PARALLELISM = 16;
 
 std::string escapePath(const std::string& str) {
   std::string data = util::Url::escape(str);
@@ -52,145 +66,911 @@ std::string escapePath(const std::string& str) {
   return result;
 }
 
-void remove(Request<EitherError<void>>::Pointer r,
-            std::shared_ptr<std::vector<IItem::Pointer>> lst,
-            std::function<void(EitherError<void>)> complete) {
-  if (lst->empty()) return complete(nullptr);
-  auto item = lst->back();
-  lst->pop_back();
-  r->subrequest(r->provider()->deleteItemAsync(item, [=](EitherError<void> e) {
-    if (e.left())
-      complete(e.left());
-    else
-      remove(r, lst, complete);
-  }));
+size_t hostOffset(const std::string& url) {
+  auto scheme = url.find("://");
+  return scheme == std::string::npos ? 0 : scheme + strlen("://");
 }
 
-void rename(Request<EitherError<void>>::Pointer r, IHttp* http,
-            std::string region,
-            std::shared_ptr<std::vector<IItem::Pointer>> lst,
-            std::string dest_id, std::string source_id,
-            std::function<void(EitherError<void>)> complete) {
-  if (lst->empty()) return complete(nullptr);
-  auto item = lst->back();
-  lst->pop_back();
-  rename(r, http, region, lst, dest_id, source_id, [=](EitherError<void> e) {
-    if (e.left())
-      complete(e.left());
-    else
-      rename(r, http, region, dest_id + "/" + item->filename(), item->id(),
-             complete);
-  });
+std::string host(std::string url) {
+  auto offset = hostOffset(url);
+  return url.substr(offset, url.find_first_of('/', offset) - offset);
 }
 
-void rename(Request<EitherError<void>>::Pointer r, IHttp* http,
-            std::string region, std::string dest_id, std::string source_id,
-            std::function<void(EitherError<void>)> complete) {
-  auto finalize = [=]() {
-    auto output = std::make_shared<std::stringstream>();
-    r->sendRequest(
-        [=](util::Output) {
-          auto data = AmazonS3::split(source_id);
-          return http->create("https://" + data.first + ".s3." + region +
-                                  ".amazonaws.com/" + escapePath(data.second),
-                              "DELETE");
-        },
-        [=](EitherError<util::Output> e) {
-          if (e.left()) {
-            complete(e.left());
-            r->done(e.left());
-          } else {
+std::string path(std::string url) {
+  auto offset = url.find_first_of('/', hostOffset(url));
+  return offset == std::string::npos ? "/" : url.substr(offset);
+}
+
+struct QueryParameter {
+  std::string name_;
+  std::string escaped_name_;
+  std::string escaped_value_;
+};
+
+std::string currentDateAndTime() {
+  auto now = std::chrono::system_clock::now();
+  auto in_time_t = std::chrono::system_clock::to_time_t(now);
+
+  std::stringstream ss;
+  ss << std::put_time(std::gmtime(&in_time_t), "%Y%m%dT%H%M%SZ");
+  return ss.str();
+}
+
+struct Object {
+  std::string key_;
+  uint64_t size_;
+};
+
+using ObjectsPage =
+    std::function<void(std::vector<Object>, std::function<void()> next)>;
+
+/**
+ * Parses ListAllMyBucketsResult, response to the request listing buckets.
+ */
+class BucketsParser : public CloudProvider::ListDirectoryParser {
+ public:
+  using BucketReceived = std::function<void(const std::string& name)>;
+
+  BucketsParser(BucketReceived bucket)
+      : bucket_(bucket),
+        parser_(std::bind(&BucketsParser::element, this, _1, _2)) {}
+
+  void write(const char* data, size_t length) override {
+    parser_.write(data, length);
+  }
+
+  bool finish(std::string&) override { return parser_.finish(); }
+
+ private:
+  void element(const std::vector<std::string>& path, const std::string& text) {
+    if (path.size() == 4 && path[1] == "Buckets" && path[3] == "Name")
+      bucket_(text);
+  }
+
+  BucketReceived bucket_;
+  util::XmlParser parser_;
+};
+
+/**
+ * Parses ListBucketResult, response to ListObjectsV2 request; objects and
+ * common prefixes are reported as soon as their elements end.
+ */
+class ListBucketParser : public CloudProvider::ListDirectoryParser {
+ public:
+  using ObjectReceived = std::function<void(Object)>;
+  using PrefixReceived = std::function<void(const std::string& prefix)>;
+
+  ListBucketParser(ObjectReceived object, PrefixReceived prefix = nullptr)
+      : object_(object),
+        prefix_(prefix),
+        parser_(std::bind(&ListBucketParser::element, this, _1, _2)),
+        is_truncated_() {}
+
+  void write(const char* data, size_t length) override {
+    parser_.write(data, length);
+  }
+
+  void write(std::istream& stream) { parser_.write(stream); }
+
+  bool finish(std::string& next_page_token) override {
+    if (!parser_.finish() || (is_truncated_ && next_token_.empty()))
+      return false;
+    next_page_token = is_truncated_ ? next_token_ : "";
+    return true;
+  }
+
+ private:
+  void element(const std::vector<std::string>& path, const std::string& text) {
+    if (path.size() == 3) {
+      if (path[1] == "Contents" && path[2] == "Key")
+        key_ = text;
+      else if (path[1] == "Contents" && path[2] == "Size")
+        size_ = text;
+      else if (path[1] == "CommonPrefixes" && path[2] == "Prefix")
+        key_ = text;
+    } else if (path.size() == 2) {
+      if (path[1] == "Contents") {
+        if (key_.empty() || size_.empty()) throw std::logic_error("no key");
+        object_({key_, static_cast<uint64_t>(std::atoll(size_.c_str()))});
+      } else if (path[1] == "CommonPrefixes") {
+        if (key_.empty()) throw std::logic_error("no prefix");
+        if (prefix_) prefix_(key_);
+      } else if (path[1] == "IsTruncated") {
+        is_truncated_ = text == "true";
+      } else if (path[1] == "NextContinuationToken") {
+        next_token_ = text;
+      }
+      key_.clear();
+      size_.clear();
+    }
+  }
+
+  ObjectReceived object_;
+  PrefixReceived prefix_;
+  util::XmlParser parser_;
+  std::string key_;
+  std::string size_;
+  bool is_truncated_;
+  std::string next_token_;
+};
+
+/**
+ * Lists all objects whose keys start with prefix, including those in nested
+ * "directories"; page is called with every page of up to 1000 objects and the
+ * next page is requested once it calls next.
+ */
+void listObjects(Request<EitherError<void>>::Pointer r, std::string bucket_url,
+                 std::string prefix, std::string token, ObjectsPage page,
+                 std::function<void(EitherError<void>)> complete) {
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output) {
+        auto request = r->provider()->http()->create(bucket_url, "GET");
+        request->setParameter("list-type", "2");
+        request->setParameter("prefix", prefix);
+        if (!token.empty()) request->setParameter("continuation-token", token);
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) return complete(e.left());
+        std::vector<Object> objects;
+        ListBucketParser parser([&objects](Object object) {
+          objects.push_back(std::move(object));
+        });
+        parser.write(*output);
+        std::string next_token;
+        if (!parser.finish(next_token))
+          return complete(Error{IHttpRequest::Failure, "invalid xml"});
+        page(std::move(objects), [=]() {
+          if (next_token.empty())
             complete(nullptr);
-            r->done(nullptr);
-          }
-        },
-        output);
-  };
-  if (!source_id.empty() && source_id.back() != '/') {
+          else
+            listObjects(r, bucket_url, prefix, next_token, page, complete);
+        });
+      },
+      output);
+}
+
+/**
+ * Deletes objects with DeleteObjects requests of up to 1000 keys, several of
+ * them at once.
+ */
+class ObjectDeleter : public std::enable_shared_from_this<ObjectDeleter> {
+ public:
+  using Pointer = std::shared_ptr<ObjectDeleter>;
+  using Callback = std::function<void(EitherError<void>)>;
+
+  ObjectDeleter(Request<EitherError<void>>::Pointer r, std::string bucket_url)
+      : request_(r), bucket_url_(std::move(bucket_url)), running_() {}
+
+  /**
+   * Queues keys to be deleted; ready is called once more keys can be added,
+   * or with the error if some batch failed.
+   */
+  void add(std::vector<std::string> keys, Callback ready) {
+    std::vector<std::vector<std::string>> batches;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error_) {
+      auto error = *error_;
+      lock.unlock();
+      return ready(error);
+    }
+    std::move(keys.begin(), keys.end(), std::back_inserter(pending_));
+    while (pending_.size() >= MAX_DELETE_KEYS) {
+      batches.emplace_back(
+          std::make_move_iterator(pending_.begin()),
+          std::make_move_iterator(pending_.begin() + MAX_DELETE_KEYS));
+      pending_.erase(pending_.begin(), pending_.begin() + MAX_DELETE_KEYS);
+    }
+    running_ += batches.size();
+    bool room = running_ < DELETE_PARALLELISM;
+    if (!room) ready_ = ready;
+    lock.unlock();
+    for (auto& batch : batches) send(std::move(batch));
+    if (room) ready(nullptr);
+  }
+
+  /**
+   * Deletes the remaining keys; complete is called once all batches are
+   * done.
+   */
+  void finish(Callback complete) {
+    std::vector<std::string> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error_) {
+      auto error = *error_;
+      lock.unlock();
+      return complete(error);
+    }
+    std::swap(batch, pending_);
+    if (!batch.empty()) running_++;
+    if (running_ == 0) {
+      lock.unlock();
+      return complete(nullptr);
+    }
+    complete_ = complete;
+    lock.unlock();
+    if (!batch.empty()) send(std::move(batch));
+  }
+
+ private:
+  void send(std::vector<std::string> keys) {
+    auto deleter = shared_from_this();
+    auto p = request_->provider();
+    if (!p) return finished(Error{IHttpRequest::Aborted, ""});
+    tinyxml2::XMLPrinter printer(nullptr, true);
+    printer.OpenElement("Delete");
+    printer.OpenElement("Quiet");
+    printer.PushText("true");
+    printer.CloseElement();
+    for (const auto& key : keys) {
+      printer.OpenElement("Object");
+      printer.OpenElement("Key");
+      printer.PushText(key.c_str());
+      printer.CloseElement();
+      printer.CloseElement();
+    }
+    printer.CloseElement();
+    std::string body = printer.CStr();
+    auto checksum = util::to_base64(p->crypto()->sha256(body));
     auto output = std::make_shared<std::stringstream>();
-    r->sendRequest(
-        [=](util::Output) {
-          auto dest_data = AmazonS3::split(dest_id);
-          auto request =
-              http->create("https://" + dest_data.first + ".s3." + region +
-                               ".amazonaws.com/" + escapePath(dest_data.second),
-                           "PUT");
-          auto source_data = AmazonS3::split(source_id);
-          request->setHeaderParameter(
-              "x-amz-copy-source",
-              escapePath("/" + source_data.first + "/" + source_data.second));
+    request_->sendRequest(
+        [=](util::Output input) {
+          *input << body;
+          auto request = p->http()->create(bucket_url_, "POST");
+          request->setParameter("delete", "");
+          // DeleteObjects requires checksum of the body
+          request->setHeaderParameter("x-amz-sdk-checksum-algorithm", "SHA256");
+          request->setHeaderParameter("x-amz-checksum-sha256", checksum);
           return request;
         },
         [=](EitherError<util::Output> e) {
-          if (e.left()) {
-            complete(e.left());
-            r->done(e.left());
-          } else {
-            finalize();
-          }
+          if (e.left()) return deleter->finished(e.left());
+          tinyxml2::XMLDocument document;
+          if (document.Parse(output->str().c_str(), output->str().size()) !=
+              tinyxml2::XML_SUCCESS)
+            return deleter->finished(
+                Error{IHttpRequest::Failure, "invalid xml"});
+          // in quiet mode response lists only keys which failed
+          if (auto error = document.RootElement()->FirstChildElement("Error"))
+            return deleter->finished(Error{
+                IHttpRequest::Failure,
+                error->FirstChildElement("Message") &&
+                        error->FirstChildElement("Message")->GetText()
+                    ? error->FirstChildElement("Message")->GetText()
+                    : output->str()});
+          deleter->finished(nullptr);
         },
         output);
-  } else {
-    r->subrequest(
-        r->provider()->getItemDataAsync(source_id, [=](EitherError<IItem> e) {
-          if (e.left()) {
-            complete(e.left());
-            return r->done(e.left());
-          }
-          r->subrequest(r->provider()->listDirectoryAsync(
-              e.right(), [=](EitherError<std::vector<IItem::Pointer>> e) {
-                if (e.left()) {
-                  complete(e.left());
-                  return r->done(e.left());
-                }
-                rename(r, http, region, e.right(), dest_id, source_id,
-                       [=](EitherError<void> e) {
-                         if (e.left()) {
-                           complete(e.left());
-                           return r->done(e.left());
-                         }
-                         finalize();
-                       });
-              }));
-        }));
   }
+
+  void finished(EitherError<void> e) {
+    Callback ready, complete;
+    std::unique_lock<std::mutex> lock(mutex_);
+    running_--;
+    if (e.left() && !error_) error_ = e.left();
+    if (ready_ && (error_ || running_ < DELETE_PARALLELISM))
+      std::swap(ready, ready_);
+    if (complete_ && (error_ || running_ == 0)) std::swap(complete, complete_);
+    auto error = error_;
+    lock.unlock();
+    if (ready) ready(error ? EitherError<void>(error) : nullptr);
+    if (complete) complete(error ? EitherError<void>(error) : nullptr);
+  }
+
+  Request<EitherError<void>>::Pointer request_;
+  std::string bucket_url_;
+  std::mutex mutex_;
+  std::vector<std::string> pending_;
+  uint32_t running_;
+  Callback ready_;
+  Callback complete_;
+  std::shared_ptr<Error> error_;
+};
+
+/**
+ * Requests which succeeded may still carry an error in their body, e.g. when
+ * it happened after server started sending the response.
+ */
+EitherError<void> responseError(const std::string& response) {
+  tinyxml2::XMLDocument document;
+  if (document.Parse(response.c_str(), response.size()) !=
+      tinyxml2::XML_SUCCESS)
+    return nullptr;
+  auto root = document.RootElement();
+  if (root->Name() != std::string("Error")) return nullptr;
+  auto message = root->FirstChildElement("Message");
+  return Error{IHttpRequest::Failure, message && message->GetText()
+                                          ? message->GetText()
+                                          : response};
 }
 
-std::string host(std::string url) {
-  const char* http = "https://";
-  return url.substr(strlen(http),
-                    url.find_first_of('/', strlen(http)) - strlen(http));
+void createMultipartUpload(Request<EitherError<void>>::Pointer r,
+                           std::string url,
+                           std::function<void(EitherError<std::string>)> f) {
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output) {
+        auto request = r->provider()->http()->create(url, "POST");
+        request->setParameter("uploads", "");
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) return f(e.left());
+        tinyxml2::XMLDocument document;
+        auto root = document.Parse(output->str().c_str(),
+                                   output->str().size()) ==
+                            tinyxml2::XML_SUCCESS
+                        ? document.RootElement()
+                        : nullptr;
+        auto upload_id = root ? root->FirstChildElement("UploadId") : nullptr;
+        if (!upload_id || !upload_id->GetText())
+          return f(Error{IHttpRequest::Failure, output->str()});
+        f(std::string(upload_id->GetText()));
+      },
+      output);
 }
 
-std::string path(std::string url) {
-  int length = host(url).length();
-  return url.substr(strlen("https://") + length);
+void completeMultipartUpload(Request<EitherError<void>>::Pointer r,
+                             std::string url, std::string upload_id,
+                             const std::vector<std::string>& etags,
+                             std::function<void(EitherError<void>)> f) {
+  tinyxml2::XMLPrinter printer(nullptr, true);
+  printer.OpenElement("CompleteMultipartUpload");
+  for (uint32_t i = 0; i < etags.size(); i++) {
+    printer.OpenElement("Part");
+    printer.OpenElement("PartNumber");
+    printer.PushText(i + 1);
+    printer.CloseElement();
+    printer.OpenElement("ETag");
+    printer.PushText(etags[i].c_str());
+    printer.CloseElement();
+    printer.CloseElement();
+  }
+  printer.CloseElement();
+  std::string body = printer.CStr();
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output input) {
+        *input << body;
+        auto request = r->provider()->http()->create(url, "POST");
+        request->setParameter("uploadId", upload_id);
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) return f(e.left());
+        f(responseError(output->str()));
+      },
+      output);
 }
 
-std::string currentDate() {
-  auto now = std::chrono::system_clock::now();
-  auto in_time_t = std::chrono::system_clock::to_time_t(now);
+/**
+ * Sent directly through provider's http engine, as the request which started
+ * the upload may be already cancelled.
+ */
+void abortMultipartUpload(std::shared_ptr<CloudProvider> p, std::string url,
+                          std::string upload_id) {
+  if (!p) return;
+  auto request = p->http()->create(url, "DELETE");
+  request->setParameter("uploadId", upload_id);
+  try {
+    p->authorizeRequest(*request);
+  } catch (const std::exception&) {
+    return;
+  }
+  request->send([](IHttpRequest::Response) {},
+                std::make_shared<std::stringstream>(),
+                std::make_shared<std::stringstream>());
+}
 
-  std::stringstream ss;
-  ss << std::put_time(std::gmtime(&in_time_t), "%Y%m%d");
-  return ss.str();
+/**
+ * Uploads the file in parts of equal size, except for the last one. Parts are
+ * read from the callback one after another on a separate thread, so that
+ * reading doesn't hold up http transfers, and up to parallelism of them are
+ * sent at once; each part is kept in memory until it's uploaded, so that it
+ * can be sent again when its transfer breaks. Upload which failed or was
+ * cancelled is aborted, so that the parts don't occupy storage.
+ */
+class MultipartUploadRequest : public Request<EitherError<void>> {
+ public:
+  MultipartUploadRequest(std::shared_ptr<CloudProvider> p, std::string url,
+                         IUploadFileCallback::Pointer callback,
+                         uint64_t part_size, uint32_t parallelism)
+      : Request(p),
+        url_(std::move(url)),
+        callback_(std::move(callback)),
+        size_(callback_->size()),
+        part_size_(std::max(part_size, (size_ + MAX_PARTS - 1) / MAX_PARTS)),
+        part_count_(static_cast<uint32_t>((size_ + part_size_ - 1) /
+                                          part_size_)),
+        parallelism_(std::max<uint32_t>(parallelism, 1)),
+        etags_(part_count_),
+        next_(),
+        running_(),
+        uploaded_(),
+        completed_(),
+        starting_(),
+        reported_() {
+    set_priority(IHttpRequest::Priority::Bulk);
+    set([=](Request::Pointer) { create(); });
+  }
+
+  ~MultipartUploadRequest() { cancel(); }
+
+ private:
+  void create() {
+    createMultipartUpload(shared_from_this(), url_,
+                          [=](EitherError<std::string> e) {
+                            if (e.left()) return fail(*e.left());
+                            {
+                              std::lock_guard<std::mutex> lock(mutex_);
+                              upload_id_ = *e.right();
+                            }
+                            // the thread keeps the request alive until it
+                            // reads all the parts or the upload is reported
+                            auto request = std::static_pointer_cast<
+                                MultipartUploadRequest>(shared_from_this());
+                            std::thread([request] { request->read(); })
+                                .detach();
+                          });
+  }
+
+  void read() {
+    callback_->reset();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (next_ < part_count_) {
+      read_condition_.wait(
+          lock, [=] { return reported_ || parts_.size() < parallelism_; });
+      if (reported_) return;
+      auto index = next_++;
+      uint64_t length =
+          std::min(part_size_, size_ - uint64_t(index) * part_size_);
+      lock.unlock();
+      auto data = std::make_shared<std::string>(length, '\0');
+      uint64_t read = 0;
+      while (read < length) {
+        auto count = callback_->putData(
+            &(*data)[read], static_cast<uint32_t>(std::min<uint64_t>(
+                                length - read, PART_READ_SIZE)));
+        if (count == 0) break;
+        read += count;
+      }
+      if (read < length)
+        return fail(Error{IHttpRequest::Failure, "couldn't read file"});
+      lock.lock();
+      parts_[index] = data;
+      waiting_.push_back(index);
+      lock.unlock();
+      start();
+      lock.lock();
+    }
+  }
+
+  void start() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (starting_) return;
+    starting_ = true;
+    while (!reported_ && running_ < parallelism_ && !waiting_.empty()) {
+      running_++;
+      auto index = waiting_.front();
+      waiting_.pop_front();
+      auto data = parts_[index];
+      lock.unlock();
+      send(index, data);
+      lock.lock();
+    }
+    starting_ = false;
+  }
+
+  void send(uint32_t index, std::shared_ptr<std::string> data) {
+    auto request = this->shared_from_this();
+    auto upload_id = this->upload_id();
+    sendRequestWithResponse(
+        [=](util::Output input) {
+          input->write(data->data(), data->size());
+          auto r = provider()->http()->create(url_, "PUT");
+          r->setParameter("partNumber", std::to_string(index + 1));
+          r->setParameter("uploadId", upload_id);
+          return r;
+        },
+        [=](EitherError<IHttpRequest::Response> e) {
+          (void)request;
+          finished(index, e);
+        },
+        std::make_shared<std::stringstream>(), nullptr,
+        [=](uint32_t, uint32_t now) { progress(index, now); });
+  }
+
+  void progress(uint32_t index, uint64_t now) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    sending_[index] = now;
+    uint64_t total = uploaded_;
+    for (const auto& p : sending_) total += p.second;
+    lock.unlock();
+    callback_->progress(static_cast<uint32_t>(size_),
+                        static_cast<uint32_t>(total));
+  }
+
+  void finished(uint32_t index, EitherError<IHttpRequest::Response> e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    running_--;
+    sending_.erase(index);
+    if (reported_) return;
+    if (e.left()) {
+      auto p = provider();
+      // sendRequest retries requests which failed with transient errors, but
+      // not those which broke during the transfer; part can be sent again
+      if (e.left()->code_ < 0 && p &&
+          ++attempts_[index] < p->retry_policy().max_attempts_) {
+        waiting_.push_front(index);
+        lock.unlock();
+        return start();
+      }
+      lock.unlock();
+      return fail(*e.left());
+    }
+    auto etag = e.right()->headers_.find("etag");
+    if (etag == e.right()->headers_.end()) {
+      lock.unlock();
+      return fail(Error{IHttpRequest::Failure, "no etag of uploaded part"});
+    }
+    etags_[index] = etag->second;
+    uploaded_ += parts_[index]->size();
+    parts_.erase(index);
+    read_condition_.notify_one();
+    if (++completed_ == part_count_) {
+      lock.unlock();
+      return complete();
+    }
+    lock.unlock();
+    start();
+  }
+
+  void complete() {
+    completeMultipartUpload(shared_from_this(), url_, upload_id(), etags_,
+                            [=](EitherError<void> e) {
+                              if (e.left()) return fail(*e.left());
+                              {
+                                std::lock_guard<std::mutex> lock(mutex_);
+                                if (reported_) return;
+                                reported_ = true;
+                              }
+                              callback_->done(nullptr);
+                              done(nullptr);
+                            });
+  }
+
+  void fail(Error e) {
+    std::string upload_id;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (reported_) return;
+      reported_ = true;
+      upload_id = upload_id_;
+    }
+    read_condition_.notify_one();
+    if (!upload_id.empty()) abortMultipartUpload(provider(), url_, upload_id);
+    callback_->done(e);
+    done(e);
+  }
+
+  std::string upload_id() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return upload_id_;
+  }
+
+  std::string url_;
+  IUploadFileCallback::Pointer callback_;
+  uint64_t size_;
+  uint64_t part_size_;
+  uint32_t part_count_;
+  uint32_t parallelism_;
+  std::mutex mutex_;
+  std::condition_variable read_condition_;
+  std::string upload_id_;
+
+  /**
+   * Parts read from the callback which weren't uploaded yet, at most
+   * parallelism of them.
+   */
+  std::map<uint32_t, std::shared_ptr<std::string>> parts_;
+
+  /**
+   * Parts which should be sent; those whose transfer broke are put in front.
+   */
+  std::deque<uint32_t> waiting_;
+  std::map<uint32_t, uint32_t> attempts_;
+  std::map<uint32_t, uint64_t> sending_;
+  std::vector<std::string> etags_;
+  uint32_t next_;
+  uint32_t running_;
+  uint64_t uploaded_;
+  uint32_t completed_;
+
+  /**
+   * Whether some thread is starting parts.
+   */
+  bool starting_;
+  bool reported_;
+};
+
+void copyPart(Request<EitherError<void>>::Pointer r, std::string url,
+              std::string copy_source, uint64_t size, std::string upload_id,
+              std::shared_ptr<std::vector<std::string>> etags,
+              std::function<void(EitherError<void>)> complete) {
+  uint64_t offset = etags->size() * COPY_PART_SIZE;
+  if (offset >= size)
+    return completeMultipartUpload(r, url, upload_id, *etags, complete);
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output) {
+        auto request = r->provider()->http()->create(url, "PUT");
+        request->setParameter("partNumber", std::to_string(etags->size() + 1));
+        request->setParameter("uploadId", upload_id);
+        request->setHeaderParameter("x-amz-copy-source", copy_source);
+        request->setHeaderParameter(
+            "x-amz-copy-source-range",
+            util::range_to_string(
+                {offset, std::min(COPY_PART_SIZE, size - offset)}));
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) return complete(e.left());
+        tinyxml2::XMLDocument document;
+        auto root =
+            document.Parse(output->str().c_str(), output->str().size()) ==
+                    tinyxml2::XML_SUCCESS
+                ? document.RootElement()
+                : nullptr;
+        auto etag = root ? root->FirstChildElement("ETag") : nullptr;
+        if (!etag || !etag->GetText())
+          return complete(Error{IHttpRequest::Failure, output->str()});
+        etags->push_back(etag->GetText());
+        copyPart(r, url, copy_source, size, upload_id, etags, complete);
+      },
+      output);
 }
 
-std::string currentDateAndTime() {
-  auto now = std::chrono::system_clock::now();
-  auto in_time_t = std::chrono::system_clock::to_time_t(now);
+/**
+ * Copies object bigger than 5 GB, which CopyObject refuses, with
+ * UploadPartCopy requests.
+ */
+void copyObjectInParts(Request<EitherError<void>>::Pointer r, std::string url,
+                       std::string copy_source, uint64_t size,
+                       std::function<void(EitherError<void>)> complete) {
+  createMultipartUpload(r, url, [=](EitherError<std::string> e) {
+    if (e.left()) return complete(e.left());
+    auto upload_id = *e.right();
+    copyPart(r, url, copy_source, size, upload_id,
+             std::make_shared<std::vector<std::string>>(),
+             [=](EitherError<void> e) {
+               if (e.left())
+                 abortMultipartUpload(r->provider(), url, upload_id);
+               complete(e);
+             });
+  });
+}
 
-  std::stringstream ss;
-  ss << std::put_time(std::gmtime(&in_time_t), "%Y%m%dT%H%M%SZ");
-  return ss.str();
+void copyObject(Request<EitherError<void>>::Pointer r,
+                std::string source_bucket, std::string source_key,
+                std::string url, uint64_t size,
+                std::function<void(EitherError<void>)> complete) {
+  auto copy_source = escapePath("/" + source_bucket + "/" + source_key);
+  if (size != IItem::UnknownSize && size > MAX_COPY_SIZE)
+    return copyObjectInParts(r, url, copy_source, size, complete);
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output) {
+        auto request = r->provider()->http()->create(url, "PUT");
+        request->setHeaderParameter("x-amz-copy-source", copy_source);
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) return complete(e.left());
+        complete(responseError(output->str()));
+      },
+      output);
+}
+
+/**
+ * Copies listed objects from source prefix to destination prefix, several at
+ * once.
+ */
+class ObjectCopier : public std::enable_shared_from_this<ObjectCopier> {
+ public:
+  using Callback = std::function<void(EitherError<void>)>;
+
+  ObjectCopier(Request<EitherError<void>>::Pointer r,
+               std::pair<std::string, std::string> source,
+               std::string destination_url, std::string destination_prefix,
+               std::vector<Object> objects, Callback complete)
+      : request_(r),
+        source_(std::move(source)),
+        destination_url_(std::move(destination_url)),
+        destination_prefix_(std::move(destination_prefix)),
+        objects_(std::move(objects)),
+        complete_(std::move(complete)),
+        next_(),
+        running_(),
+        reported_() {}
+
+  void start() {
+    auto copier = shared_from_this();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!reported_ && running_ < COPY_PARALLELISM &&
+           next_ < objects_.size()) {
+      const auto& object = objects_[next_++];
+      auto url = destination_url_ +
+                 escapePath(destination_prefix_ +
+                            object.key_.substr(source_.second.size()));
+      running_++;
+      lock.unlock();
+      copyObject(request_, source_.first, object.key_, url, object.size_,
+                 [=](EitherError<void> e) { copier->finished(e); });
+      lock.lock();
+    }
+    if (!reported_ && running_ == 0 && next_ == objects_.size()) {
+      reported_ = true;
+      lock.unlock();
+      complete_(nullptr);
+    }
+  }
+
+ private:
+  void finished(EitherError<void> e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    running_--;
+    if (e.left()) {
+      if (reported_) return;
+      reported_ = true;
+      lock.unlock();
+      return complete_(e.left());
+    }
+    lock.unlock();
+    start();
+  }
+
+  Request<EitherError<void>>::Pointer request_;
+  std::pair<std::string, std::string> source_;
+  std::string destination_url_;
+  std::string destination_prefix_;
+  std::vector<Object> objects_;
+  Callback complete_;
+  std::mutex mutex_;
+  size_t next_;
+  uint32_t running_;
+  bool reported_;
+};
+
+/**
+ * Moves object or all objects under "directory" prefix to destination; all
+ * objects of a page of the listing are copied before they get deleted with
+ * DeleteObjects and the next page is listed.
+ */
+void rename(Request<EitherError<void>>::Pointer r, std::string source_url,
+            std::string destination_url, std::string source_id,
+            std::string destination_id, uint64_t size,
+            std::function<void(EitherError<void>)> complete) {
+  auto source = AmazonS3::split(source_id);
+  auto destination = AmazonS3::split(destination_id);
+  if (source.second.empty() || destination.second.empty())
+    return complete(Error{IHttpRequest::Forbidden, "can't move bucket"});
+  if (source.second.back() != '/') {
+    return copyObject(
+        r, source.first, source.second,
+        destination_url + escapePath(destination.second), size,
+        [=](EitherError<void> e) {
+          if (e.left()) return complete(e.left());
+          auto output = std::make_shared<std::stringstream>();
+          r->sendRequest(
+              [=](util::Output) {
+                return r->provider()->http()->create(
+                    source_url + escapePath(source.second), "DELETE");
+              },
+              [=](EitherError<util::Output> e) {
+                if (e.left())
+                  complete(e.left());
+                else
+                  complete(nullptr);
+              },
+              output);
+        });
+  }
+  if (source.first == destination.first &&
+      destination.second.compare(0, source.second.size(), source.second) == 0)
+    return complete(Error{IHttpRequest::Forbidden,
+                          "can't move directory into itself"});
+  auto deleter = std::make_shared<ObjectDeleter>(r, source_url);
+  listObjects(
+      r, source_url, source.second, "",
+      [=](std::vector<Object> objects, std::function<void()> next) {
+        std::vector<std::string> keys;
+        for (const auto& object : objects) keys.push_back(object.key_);
+        std::make_shared<ObjectCopier>(
+            r, source, destination_url, destination.second, std::move(objects),
+            [=](EitherError<void> e) {
+              if (e.left()) return complete(e.left());
+              deleter->add(keys, [=](EitherError<void> e) {
+                if (e.left())
+                  complete(e.left());
+                else
+                  next();
+              });
+            })
+            ->start();
+      },
+      [=](EitherError<void> e) {
+        if (e.left()) return complete(e.left());
+        deleter->finish(complete);
+      });
+}
+
+/**
+ * Fetches "directory" whose id lacks the trailing slash, e.g. one made from a
+ * path; it exists if any object's key starts with it.
+ */
+void getDirectory(Request<EitherError<IItem>>::Pointer r,
+                  std::string bucket_url, std::string id,
+                  GetItemDataCallback complete) {
+  auto prefix = AmazonS3::split(id).second + "/";
+  auto output = std::make_shared<std::stringstream>();
+  r->sendRequest(
+      [=](util::Output) {
+        auto request = r->provider()->http()->create(bucket_url, "GET");
+        request->setParameter("list-type", "2");
+        request->setParameter("prefix", prefix);
+        request->setParameter("max-keys", "1");
+        return request;
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left()) {
+          complete(e.left());
+          return r->done(e.left());
+        }
+        bool found = false;
+        ListBucketParser parser([&found](Object) { found = true; });
+        parser.write(*output);
+        std::string next_token;
+        parser.finish(next_token);
+        if (!found) {
+          Error e{IHttpRequest::NotFound, "not found"};
+          complete(e);
+          return r->done(e);
+        }
+        auto item =
+            std::make_shared<Item>(CloudProvider::getFilename(prefix), id + "/",
+                                   IItem::UnknownSize,
+                                   IItem::FileType::Directory);
+        complete(EitherError<IItem>(item));
+        r->done(EitherError<IItem>(item));
+      },
+      output);
 }
 
 }  // namespace
 
-AmazonS3::AmazonS3() : CloudProvider(util::make_unique<Auth>()) {}
+AmazonS3::AmazonS3()
+    : CloudProvider(util::make_unique<Auth>()),
+      path_style_(),
+      part_size_(PART_SIZE),
+      upload_parallelism_(UPLOAD_PARALLELISM) {}
 
 void AmazonS3::initialize(InitData&& init_data) {
   unpackCredentials(init_data.token_);
+  setWithHint(init_data.hints_, "s3_endpoint", [this](std::string v) {
+    while (!v.empty() && v.back() == '/') v.pop_back();
+    endpoint_ = v;
+    path_style_ = !v.empty();
+  });
+  setWithHint(init_data.hints_, "s3_path_style",
+              [this](std::string v) { path_style_ = v == "true"; });
+  setWithHint(init_data.hints_, "s3_part_size", [this](std::string v) {
+    part_size_ = std::max<uint64_t>(std::atoll(v.c_str()), MIN_PART_SIZE);
+  });
+  setWithHint(init_data.hints_, "s3_upload_parallelism",
+              [this](std::string v) {
+                upload_parallelism_ = std::max(1, std::atoi(v.c_str()));
+              });
   CloudProvider::initialize(std::move(init_data));
 }
 
@@ -201,26 +981,56 @@ std::string AmazonS3::token() const {
 std::string AmazonS3::name() const { return "amazons3"; }
 
 std::string AmazonS3::endpoint() const {
-  return "https://s3-" + region() + ".amazonaws.com";
+  if (!endpoint_.empty()) return endpoint_;
+  return "https://s3." + region() + ".amazonaws.com";
+}
+
+std::string AmazonS3::bucketUrl(const std::string& bucket) const {
+  if (path_style_) return endpoint() + "/" + bucket + "/";
+  auto base = endpoint();
+  auto offset = hostOffset(base);
+  return base.substr(0, offset) + bucket + "." + base.substr(offset) + "/";
 }
 
 AuthorizeRequest::Pointer AmazonS3::authorizeAsync() {
   return std::make_shared<SimpleAuthorization>(shared_from_this());
 }
 
+ICloudProvider::UploadFileRequest::Pointer AmazonS3::uploadFileAsync(
+    IItem::Pointer directory, const std::string& filename,
+    IUploadFileCallback::Pointer callback) {
+  if (callback->size() <= part_size_)
+    return CloudProvider::uploadFileAsync(directory, filename, callback);
+  auto data = split(directory->id());
+  return std::make_shared<MultipartUploadRequest>(
+             shared_from_this(),
+             bucketUrl(data.first) + escapePath(data.second + filename),
+             callback, part_size_, upload_parallelism_)
+      ->run();
+}
+
 ICloudProvider::MoveItemRequest::Pointer AmazonS3::moveItemAsync(
     IItem::Pointer source, IItem::Pointer destination,
     MoveItemCallback callback) {
+  callback = invalidatePaths(source, destination, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
-    rename(r, http(), region(), destination->id() + source->filename(),
-           source->id(), callback);
+    std::string destination_id = destination->id() + source->filename();
+    if (source->type() == IItem::FileType::Directory) destination_id += "/";
+    rename(r, bucketUrl(split(source->id()).first),
+           bucketUrl(split(destination_id).first), source->id(),
+           destination_id, source->size(),
+           [=](EitherError<void> e) {
+             callback(e);
+             r->done(e);
+           });
   });
   return r->run();
 }
 
 ICloudProvider::RenameItemRequest::Pointer AmazonS3::renameItemAsync(
     IItem::Pointer item, const std::string& name, RenameItemCallback callback) {
+  callback = invalidatePaths(item, nullptr, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
     std::string path = split(item->id()).second;
@@ -229,7 +1039,14 @@ ICloudProvider::RenameItemRequest::Pointer AmazonS3::renameItemAsync(
       path = split(item->id()).first + Auth::SEPARATOR;
     else
       path = split(item->id()).first + Auth::SEPARATOR + getPath(path) + "/";
-    rename(r, http(), region(), path + name, item->id(), callback);
+    path += name;
+    if (item->type() == IItem::FileType::Directory) path += "/";
+    auto bucket_url = bucketUrl(split(item->id()).first);
+    rename(r, bucket_url, bucket_url, item->id(), path, item->size(),
+           [=](EitherError<void> e) {
+             callback(e);
+             r->done(e);
+           });
   });
   return r->run();
 }
@@ -237,16 +1054,16 @@ ICloudProvider::RenameItemRequest::Pointer AmazonS3::renameItemAsync(
 ICloudProvider::CreateDirectoryRequest::Pointer AmazonS3::createDirectoryAsync(
     IItem::Pointer parent, const std::string& name,
     CreateDirectoryCallback callback) {
+  callback = invalidatePaths(nullptr, parent, callback);
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
   r->set([=](Request<EitherError<IItem>>::Pointer r) {
     auto output = std::make_shared<std::stringstream>();
     r->sendRequest(
         [=](util::Output) {
           auto data = split(parent->id());
-          return http()->create("https://" + data.first + ".s3." + region() +
-                                    ".amazonaws.com/" +
-                                    escapePath(data.second + name + "/"),
-                                "PUT");
+          return http()->create(
+              bucketUrl(data.first) + escapePath(data.second + name + "/"),
+              "PUT");
         },
         [=](EitherError<util::Output> e) {
           if (e.left()) {
@@ -268,59 +1085,109 @@ ICloudProvider::CreateDirectoryRequest::Pointer AmazonS3::createDirectoryAsync(
 
 ICloudProvider::DeleteItemRequest::Pointer AmazonS3::deleteItemAsync(
     IItem::Pointer item, DeleteItemCallback callback) {
+  callback = invalidatePaths(item, nullptr, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
+    auto data = split(item->id());
+    auto bucket_url = bucketUrl(data.first);
+    auto complete = [=](EitherError<void> e) {
+      callback(e);
+      r->done(e);
+    };
     auto release = [=] {
       auto output = std::make_shared<std::stringstream>();
       r->sendRequest(
           [=](util::Output) {
-            auto data = split(item->id());
-            return http()->create("https://" + data.first + ".s3." + region() +
-                                      ".amazonaws.com/" +
-                                      escapePath(data.second),
+            return http()->create(bucket_url + escapePath(data.second),
                                   "DELETE");
           },
           [=](EitherError<util::Output> e) {
-            if (e.left()) {
-              callback(e.left());
-              r->done(e.left());
-            } else {
-              callback(nullptr);
-              r->done(nullptr);
-            }
+            if (e.left())
+              complete(e.left());
+            else
+              complete(nullptr);
           },
           output);
     };
-    if (item->type() == IItem::FileType::Directory) {
-      r->subrequest(r->provider()->listDirectoryAsync(
-          item, [=](EitherError<std::vector<IItem::Pointer>> e) {
-            if (e.left()) {
-              callback(e.left());
-              return r->done(e.left());
-            }
-            remove(r, e.right(), [=](EitherError<void> e) {
-              if (e.left()) {
-                callback(e.left());
-                return r->done(e.left());
-              }
+    if (item->type() != IItem::FileType::Directory) return release();
+    auto deleter = std::make_shared<ObjectDeleter>(r, bucket_url);
+    listObjects(
+        r, bucket_url, data.second, "",
+        [=](std::vector<Object> objects, std::function<void()> next) {
+          std::vector<std::string> keys;
+          for (auto& object : objects) keys.push_back(std::move(object.key_));
+          deleter->add(std::move(keys), [=](EitherError<void> e) {
+            if (e.left())
+              complete(e.left());
+            else
+              next();
+          });
+        },
+        [=](EitherError<void> e) {
+          if (e.left()) return complete(e.left());
+          deleter->finish([=](EitherError<void> e) {
+            if (e.left()) return complete(e.left());
+            // the directory's own key was among the listed ones, only bucket
+            // has to be removed separately
+            if (data.second.empty())
               release();
-            });
-          }));
-    } else
-      release();
+            else
+              complete(nullptr);
+          });
+        });
   });
   return r->run();
 }
 
+std::string AmazonS3::pathToId(const std::string& path) const {
+  auto separator = path.find_first_of('/', 1);
+  if (separator == std::string::npos) return path.substr(1) + Auth::SEPARATOR;
+  return path.substr(1, separator - 1) + Auth::SEPARATOR +
+         path.substr(separator + 1);
+}
+
 ICloudProvider::GetItemDataRequest::Pointer AmazonS3::getItemDataAsync(
     const std::string& id, GetItemCallback callback) {
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
   r->set([=](Request<EitherError<IItem>>::Pointer r) {
+    auto data = split(id);
+    auto bucket_url = bucketUrl(data.first);
+    if (!data.second.empty() && data.second.back() != '/') {
+      // object's metadata comes in headers of HEAD request
+      auto output = std::make_shared<std::stringstream>();
+      return r->sendRequestWithResponse(
+          [=](util::Output) {
+            return http()->create(bucket_url + escapePath(data.second),
+                                  "HEAD");
+          },
+          [=](EitherError<IHttpRequest::Response> e) {
+            if (e.left() && e.left()->code_ == IHttpRequest::NotFound)
+              return getDirectory(r, bucket_url, id, callback);
+            if (e.left()) {
+              callback(e.left());
+              return r->done(e.left());
+            }
+            const auto& headers = e.right()->headers_;
+            auto content_length = headers.find("content-length");
+            auto item = std::make_shared<Item>(
+                getFilename(data.second), id,
+                content_length != headers.end()
+                    ? static_cast<size_t>(
+                          std::atoll(content_length->second.c_str()))
+                    : IItem::UnknownSize,
+                IItem::FileType::Unknown);
+            auto content_type = headers.find("content-type");
+            if (item->type() == IItem::FileType::Unknown &&
+                content_type != headers.end())
+              item->set_type(Item::fromMimeType(content_type->second));
+            item->set_url_resolver(urlResolver());
+            callback(EitherError<IItem>(item));
+            r->done(EitherError<IItem>(item));
+          },
+          output);
+    }
     auto factory = [=](util::Output) {
-      auto data = split(id);
-      auto request = http()->create(
-          "https://" + data.first + ".s3." + region() + ".amazonaws.com/",
-          "GET");
+      auto request = http()->create(bucket_url, "GET");
       request->setParameter("list-type", "2");
       request->setParameter("prefix", data.second);
       request->setParameter("delimiter", data.second);
@@ -334,31 +1201,19 @@ ICloudProvider::GetItemDataRequest::Pointer AmazonS3::getItemDataAsync(
             callback(e.left());
             return r->done(e.left());
           }
-          std::stringstream sstream;
-          sstream << output->rdbuf();
-          tinyxml2::XMLDocument document;
-          if (document.Parse(sstream.str().c_str(), sstream.str().size()) !=
-              tinyxml2::XML_SUCCESS) {
+          auto size = IItem::UnknownSize;
+          ListBucketParser parser([&size](Object object) {
+            if (size == IItem::UnknownSize) size = object.size_;
+          });
+          parser.write(*output);
+          std::string next_token;
+          if (!parser.finish(next_token)) {
             Error e{IHttpRequest::Failure, "invalid xml"};
             callback(e);
             return r->done(e);
           }
-          auto get_size = [](const tinyxml2::XMLNode* node) {
-            auto contents_element = node->FirstChildElement("Contents");
-            if (!contents_element) return IItem::UnknownSize;
-            auto size_element = contents_element->FirstChildElement("Size");
-            if (!size_element) return IItem::UnknownSize;
-            auto text = size_element->GetText();
-            return text ? (size_t)std::atoll(text) : IItem::UnknownSize;
-          };
-          auto data = split(id);
-          auto item = std::make_shared<Item>(
-              getFilename(data.second), id, get_size(document.RootElement()),
-              (data.second.empty() || data.second.back() == '/')
-                  ? IItem::FileType::Directory
-                  : IItem::FileType::Unknown);
-          if (item->type() != IItem::FileType::Directory)
-            item->set_url(getUrl(*item));
+          auto item = std::make_shared<Item>(getFilename(data.second), id,
+                                             size, IItem::FileType::Directory);
           callback(EitherError<IItem>(item));
           r->done(EitherError<IItem>(item));
         },
@@ -373,8 +1228,7 @@ IHttpRequest::Pointer AmazonS3::listDirectoryRequest(
     return http()->create(endpoint() + "/", "GET");
   else {
     auto data = split(item.id());
-    auto request = http()->create(
-        "https://" + data.first + ".s3." + region() + ".amazonaws.com/", "GET");
+    auto request = http()->create(bucketUrl(data.first), "GET");
     request->setParameter("list-type", "2");
     request->setParameter("prefix", data.second);
     request->setParameter("delimiter", "/");
@@ -389,85 +1243,69 @@ IHttpRequest::Pointer AmazonS3::uploadFileRequest(const IItem& directory,
                                                   std::ostream&,
                                                   std::ostream&) const {
   auto data = split(directory.id());
-  return http()->create("https://" + data.first + ".s3." + region() +
-                            ".amazonaws.com/" +
-                            escapePath(data.second + filename),
-                        "PUT");
+  return http()->create(
+      bucketUrl(data.first) + escapePath(data.second + filename), "PUT");
 }
 
 IHttpRequest::Pointer AmazonS3::downloadFileRequest(const IItem& item,
                                                     std::ostream&) const {
   auto data = split(item.id());
-  return http()->create("https://" + data.first + ".s3." + region() +
-                            ".amazonaws.com/" + escapePath(data.second),
+  return http()->create(bucketUrl(data.first) + escapePath(data.second),
                         "GET");
 }
 
 std::vector<IItem::Pointer> AmazonS3::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str(), sstream.str().size()) !=
-      tinyxml2::XML_SUCCESS)
-    throw std::logic_error("invalid xml");
-  std::vector<IItem::Pointer> result;
-  if (auto buckets = document.RootElement()->FirstChildElement("Buckets")) {
-    for (auto child = buckets->FirstChild(); child;
-         child = child->NextSibling()) {
-      auto name_element = child->FirstChildElement("Name");
-      if (!name_element) throw std::logic_error("invalid xml");
-      std::string name = name_element->GetText();
-      auto item = util::make_unique<Item>(name, name + Auth::SEPARATOR, -1,
-                                          IItem::FileType::Directory);
-      result.push_back(std::move(item));
-    }
-  } else if (auto name_element =
-                 document.RootElement()->FirstChildElement("Name")) {
-    std::string bucket = name_element->GetText();
-    for (auto child = document.RootElement()->FirstChildElement("Contents");
-         child; child = child->NextSiblingElement("Contents")) {
-      auto size_element = child->FirstChildElement("Size");
-      if (!size_element) throw std::logic_error("invalid xml");
-      auto size = std::atoll(size_element->GetText());
-      if (size == 0) continue;
-      auto key_element = child->FirstChildElement("Key");
-      if (!key_element) throw std::logic_error("invalid xml");
-      std::string id = key_element->GetText();
-      auto item = util::make_unique<Item>(getFilename(id),
-                                          bucket + Auth::SEPARATOR + id, size,
-                                          IItem::FileType::Unknown);
-      item->set_url(getUrl(*item));
-      result.push_back(std::move(item));
-    }
-    for (auto child =
-             document.RootElement()->FirstChildElement("CommonPrefixes");
-         child; child = child->NextSiblingElement("CommonPrefixes")) {
-      auto prefix_element = child->FirstChildElement("Prefix");
-      if (!prefix_element) throw std::logic_error("invalid xml");
-      std::string id = prefix_element->GetText();
-      auto item = util::make_unique<Item>(
-          getFilename(id), bucket + Auth::SEPARATOR + id, IItem::UnknownSize,
-          IItem::FileType::Directory);
-      result.push_back(std::move(item));
-    }
-    auto is_truncated_element =
-        document.RootElement()->FirstChildElement("IsTruncated");
-    if (!is_truncated_element) throw std::logic_error("invalid xml");
-    if (is_truncated_element->GetText() == std::string("true")) {
-      auto next_token_element =
-          document.RootElement()->FirstChildElement("NextContinuationToken");
-      if (!next_token_element) throw std::logic_error("invalid xml");
-      next_page_token = next_token_element->GetText();
-    }
-  }
-  return result;
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
+
+CloudProvider::ListDirectoryParser::Pointer AmazonS3::listDirectoryParser(
+    const IItem& directory, ListDirectoryParser::ItemReceived received) const {
+  if (directory.id() == rootDirectory()->id())
+    return std::make_shared<BucketsParser>([=](const std::string& name) {
+      received(util::make_unique<Item>(name, name + Auth::SEPARATOR,
+                                       IItem::UnknownSize,
+                                       IItem::FileType::Directory));
+    });
+  auto bucket = split(directory.id()).first;
+  auto url_resolver = urlResolver();
+  return std::make_shared<ListBucketParser>(
+      [=](Object object) {
+        if (object.size_ == 0) return;
+        auto item = util::make_unique<Item>(
+            getFilename(object.key_), bucket + Auth::SEPARATOR + object.key_,
+            object.size_, IItem::FileType::Unknown);
+        item->set_url_resolver(url_resolver);
+        received(std::move(item));
+      },
+      [=](const std::string& prefix) {
+        received(util::make_unique<Item>(
+            getFilename(prefix), bucket + Auth::SEPARATOR + prefix,
+            IItem::UnknownSize, IItem::FileType::Directory));
+      });
+}
+
+std::vector<std::string> AmazonS3::parentIds(const IItem& item) const {
+  if (item.id() == rootDirectory()->id()) return {};
+  auto data = split(item.id());
+  std::string path = data.second;
+  if (path.empty()) return {rootDirectory()->id()};
+  if (path.back() == '/') path.pop_back();
+  if (path.find_first_of('/') == std::string::npos)
+    return {data.first + Auth::SEPARATOR};
+  return {data.first + Auth::SEPARATOR + getPath(path) + "/"};
+}
+
+void AmazonS3::restoreItem(Item& item) const {
+  if (item.type() != IItem::FileType::Directory)
+    item.set_url_resolver(urlResolver());
 }
 
 void AmazonS3::authorizeRequest(IHttpRequest& request) const {
   if (!crypto()) throw std::runtime_error("no crypto functions provided");
-  std::string current_date = currentDate();
   std::string time = currentDateAndTime();
+  std::string current_date = time.substr(0, strlen("YYYYMMDD"));
   std::string scope = current_date + "/" + region() + "/s3/aws4_request";
   request.setParameter("X-Amz-Algorithm", "AWS4-HMAC-SHA256");
   request.setParameter("X-Amz-Credential", access_id() + "/" + scope);
@@ -476,64 +1314,71 @@ void AmazonS3::authorizeRequest(IHttpRequest& request) const {
   request.setHeaderParameter("host", host(request.url()));
 
   std::vector<std::pair<std::string, std::string>> header_parameters;
-  for (auto q : request.headerParameters())
-    header_parameters.push_back({q.first, q.second});
+  header_parameters.reserve(request.headerParameters().size());
+  for (const auto& q : request.headerParameters()) {
+    std::string name = q.first;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    header_parameters.emplace_back(std::move(name), q.second);
+  }
   std::sort(header_parameters.begin(), header_parameters.end());
 
   std::string signed_headers;
-  {
-    bool first = false;
-    for (auto q : header_parameters) {
-      if (first)
-        signed_headers += ";";
-      else
-        first = true;
-      signed_headers += q.first;
-    }
-    request.setParameter("X-Amz-SignedHeaders", signed_headers);
+  for (const auto& q : header_parameters) {
+    if (!signed_headers.empty()) signed_headers += ';';
+    signed_headers += q.first;
   }
+  request.setParameter("X-Amz-SignedHeaders", signed_headers);
 
-  std::vector<std::pair<std::string, std::string>> query_parameters;
-  for (auto q : request.parameters())
-    query_parameters.push_back({q.first, q.second});
-  std::sort(query_parameters.begin(), query_parameters.end());
-
-  std::string canonical_request =
-      request.method() + "\n" + path(request.url()) + "\n";
-
-  bool first = false;
-  for (auto q : query_parameters) {
-    if (first)
-      canonical_request += "&";
-    else
-      first = true;
-    canonical_request +=
-        util::Url::escape(q.first) + "=" + util::Url::escape(q.second);
+  std::vector<QueryParameter> query_parameters;
+  query_parameters.reserve(request.parameters().size());
+  size_t length = request.method().size() + request.url().size() +
+                  signed_headers.size() + strlen("UNSIGNED-PAYLOAD");
+  for (const auto& q : request.parameters()) {
+    query_parameters.push_back({q.first, util::Url::escape(q.first),
+                                util::Url::escape(q.second)});
+    length += query_parameters.back().escaped_name_.size() +
+              query_parameters.back().escaped_value_.size() + 2;
   }
-  canonical_request += "\n";
+  std::sort(query_parameters.begin(), query_parameters.end(),
+            [](const QueryParameter& a, const QueryParameter& b) {
+              return a.escaped_name_ < b.escaped_name_;
+            });
+  for (const auto& q : header_parameters)
+    length += q.first.size() + q.second.size() + 2;
 
-  for (auto q : header_parameters)
-    canonical_request += util::Url::escape(q.first) + ":" + q.second + "\n";
-  canonical_request += "\n";
-  canonical_request += signed_headers + "\n";
+  std::string canonical_request;
+  canonical_request.reserve(length + 8);
+  canonical_request += request.method();
+  canonical_request += '\n';
+  canonical_request += path(request.url());
+  canonical_request += '\n';
+  for (const auto& q : query_parameters) {
+    if (&q != &query_parameters.front()) canonical_request += '&';
+    canonical_request += q.escaped_name_;
+    canonical_request += '=';
+    canonical_request += q.escaped_value_;
+  }
+  canonical_request += '\n';
+  for (const auto& q : header_parameters) {
+    canonical_request += q.first;
+    canonical_request += ':';
+    canonical_request += q.second;
+    canonical_request += '\n';
+  }
+  canonical_request += '\n';
+  canonical_request += signed_headers;
+  canonical_request += '\n';
   canonical_request += "UNSIGNED-PAYLOAD";
 
-  auto hash = std::bind(&ICrypto::sha256, crypto(), _1);
-  auto sign = std::bind(&ICrypto::hmac_sha256, crypto(), _1, _2);
-  auto hex = std::bind(&ICrypto::hex, crypto(), _1);
-
-  std::string string_to_sign = "AWS4-HMAC-SHA256\n" + time + "\n" + scope +
-                               "\n" + hex(hash(canonical_request));
-  std::string key =
-      sign(sign(sign(sign("AWS4" + secret(), current_date), region()), "s3"),
-           "aws4_request");
-  std::string signature = hex(sign(key, string_to_sign));
+  std::string string_to_sign =
+      "AWS4-HMAC-SHA256\n" + time + "\n" + scope + "\n" +
+      crypto()->hex(crypto()->sha256(canonical_request));
+  std::string signature = crypto()->hex(
+      crypto()->hmac_sha256(signingKey(current_date), string_to_sign));
 
+  for (auto& q : query_parameters)
+    request.setParameter(q.name_, std::move(q.escaped_value_));
   request.setParameter("X-Amz-Signature", signature);
-
-  auto params = request.parameters();
-  for (auto p : params)
-    request.setParameter(p.first, util::Url::escape(p.second));
 }
 
 bool AmazonS3::reauthorize(int code) const {
@@ -556,6 +1401,17 @@ std::string AmazonS3::region() const {
   return region_;
 }
 
+std::string AmazonS3::signingKey(const std::string& date) const {
+  auto lock = auth_lock();
+  if (signing_key_.empty() || signing_key_date_ != date) {
+    auto sign = std::bind(&ICrypto::hmac_sha256, crypto(), _1, _2);
+    signing_key_ = sign(sign(sign(sign("AWS4" + secret_, date), region_), "s3"),
+                        "aws4_request");
+    signing_key_date_ = date;
+  }
+  return signing_key_;
+}
+
 std::pair<std::string, std::string> AmazonS3::split(const std::string& str) {
   return credentialsFromString(str);
 }
@@ -569,14 +1425,14 @@ bool AmazonS3::unpackCredentials(const std::string& code) {
   access_id_ = code.substr(0, at_position);
   region_ = code.substr(at_position + 1, separator - at_position - 1);
   secret_ = code.substr(separator + strlen(Auth::SEPARATOR));
+  signing_key_.clear();
   return true;
 }
 
 std::string AmazonS3::getUrl(const Item& item) const {
   auto data = split(item.id());
-  auto request = http()->create("https://" + data.first + ".s3." + region() +
-                                    ".amazonaws.com/" + escapePath(data.second),
-                                "GET");
+  auto request = http()->create(
+      bucketUrl(data.first) + escapePath(data.second), "GET");
   authorizeRequest(*request);
   std::string parameters;
   for (const auto& p : request->parameters())
@@ -584,6 +1440,15 @@ std::string AmazonS3::getUrl(const Item& item) const {
   return request->url() + "?" + parameters;
 }
 
+Item::UrlResolver AmazonS3::urlResolver() const {
+  std::weak_ptr<const AmazonS3> provider =
+      std::static_pointer_cast<const AmazonS3>(shared_from_this());
+  return [provider](const Item& item) {
+    auto p = provider.lock();
+    return p ? p->getUrl(item) : "";
+  };
+}
+
 AmazonS3::Auth::Auth() {}
 
 std::string AmazonS3::Auth::authorizeLibraryUrl() const {
@@ -32,10 +32,13 @@ namespace cloudstorage {
 
 /**
  * AmazonS3 requires computing HMAC-SHA256 hashes, so it requires a valid
- * ICrypto implementation. Be careful about renaming and moving directories,
- * because there has to be an http request per each of its subelement. Buckets
- * are listed as root directory's children, renaming and moving them doesn't
- * work. Access token is of shape: access_id\@region##secret.
+ * ICrypto implementation. Renaming and moving directories copies each object
+ * under its prefix on the server side, several of them at once, and then
+ * deletes the originals in batches. Buckets are listed as root directory's
+ * children, renaming and moving them doesn't work. Access token is of shape:
+ * access_id\@region##secret. Files bigger than s3_part_size are uploaded with
+ * multipart upload, s3_upload_parallelism parts at once. Hints s3_endpoint and
+ * s3_path_style point the provider to any S3 compatible server.
  */
 class AmazonS3 : public CloudProvider {
  public:
@@ -48,6 +51,10 @@ class AmazonS3 : public CloudProvider {
   std::string endpoint() const override;
 
   AuthorizeRequest::Pointer authorizeAsync() override;
+  UploadFileRequest::Pointer uploadFileAsync(
+      IItem::Pointer, const std::string& filename,
+      IUploadFileCallback::Pointer) override;
+  std::string pathToId(const std::string& path) const override;
   GetItemDataRequest::Pointer getItemDataAsync(const std::string& id,
                                                GetItemDataCallback f) override;
   MoveItemRequest::Pointer moveItemAsync(IItem::Pointer source,
@@ -73,10 +80,18 @@ class AmazonS3 : public CloudProvider {
 
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
 
   void authorizeRequest(IHttpRequest&) const override;
   bool reauthorize(int) const override;
 
+  /**
+   * Parent's id is item's key without its last component.
+   */
+  std::vector<std::string> parentIds(const IItem&) const override;
+  void restoreItem(Item&) const override;
+
   std::string access_id() const;
   std::string secret() const;
   std::string region() const;
@@ -103,9 +118,33 @@ class AmazonS3 : public CloudProvider {
   bool unpackCredentials(const std::string&) override;
   std::string getUrl(const Item&) const;
 
+  /**
+   * Presigning the url costs a signature, so it's done only when the item's
+   * url is read.
+   */
+  Item::UrlResolver urlResolver() const;
+
+  /**
+   * Derived key used to sign requests; it depends only on the date, region
+   * and secret, so it's computed once a day.
+   */
+  std::string signingKey(const std::string& date) const;
+
+  /**
+   * Every bucket and object url is built here, objects' urls are bucket's
+   * url followed by escaped key.
+   */
+  std::string bucketUrl(const std::string& bucket) const;
+
   std::string access_id_;
   std::string secret_;
   std::string region_;
+  mutable std::string signing_key_;
+  mutable std::string signing_key_date_;
+  std::string endpoint_;
+  bool path_style_;
+  uint64_t part_size_;
+  uint32_t upload_parallelism_;
 };
 
 }  // namespace cloudstorage
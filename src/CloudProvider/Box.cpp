@@ -224,20 +224,25 @@ IItem::Pointer Box::getItemDataResponse(std::istream& stream) const {
 }
 
 std::vector<IItem::Pointer> Box::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  Json::Value response;
-  stream >> response;
-  std::vector<IItem::Pointer> result;
-  for (const Json::Value& v : response["entries"]) result.push_back(toItem(v));
-  int offset = response["offset"].asInt();
-  int limit = response["limit"].asInt();
-  int total_count = response["total_count"].asInt();
-  if (offset + limit < total_count)
-    next_page_token = std::to_string(offset + limit);
-  return result;
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
+
+CloudProvider::ListDirectoryParser::Pointer Box::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "entries", [=](const util::JsonView& v) { return toItem(v); }, received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        int offset = response["offset"].asInt();
+        int limit = response["limit"].asInt();
+        int total_count = response["total_count"].asInt();
+        if (offset + limit < total_count)
+          next_page_token = std::to_string(offset + limit);
+      });
 }
 
-IItem::Pointer Box::toItem(const Json::Value& v) const {
+IItem::Pointer Box::toItem(const util::JsonView& v) const {
   IItem::FileType type = IItem::FileType::Unknown;
   if (v["type"].asString() == "folder") type = IItem::FileType::Directory;
   auto item = util::make_unique<Item>(v["name"].asString(), v["id"].asString(),
@@ -0,0 +1,381 @@
+/*****************************************************************************
+ * CachedCloudProvider.cpp : CachedCloudProvider implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "CachedCloudProvider.h"
+
+#include "Request/Request.h"
+#include "Utility/Item.h"
+#include "Utility/Utility.h"
+
+namespace cloudstorage {
+
+namespace {
+
+using ItemList = std::vector<IItem::Pointer>;
+
+class ListCallback : public IListDirectoryCallback {
+ public:
+  ListCallback(MetadataCache::Pointer cache, const std::string& id,
+               uint64_t generation, IListDirectoryCallback::Pointer callback,
+               std::function<void()> finished = nullptr)
+      : cache_(cache),
+        id_(id),
+        generation_(generation),
+        callback_(callback),
+        finished_(finished) {}
+
+  void receivedItem(IItem::Pointer item) override {
+    if (callback_) callback_->receivedItem(item);
+  }
+
+  void done(EitherError<ItemList> e) override {
+    if (e.right()) cache_->putListing(id_, *e.right(), generation_);
+    if (callback_) callback_->done(e);
+    if (finished_) finished_();
+  }
+
+ private:
+  MetadataCache::Pointer cache_;
+  std::string id_;
+  uint64_t generation_;
+  IListDirectoryCallback::Pointer callback_;
+  std::function<void()> finished_;
+};
+
+class SimpleListCallback : public IListDirectoryCallback {
+ public:
+  SimpleListCallback(cloudstorage::ListDirectoryCallback callback)
+      : callback_(callback) {}
+
+  void receivedItem(IItem::Pointer) override {}
+
+  void done(EitherError<ItemList> result) override { callback_(result); }
+
+ private:
+  cloudstorage::ListDirectoryCallback callback_;
+};
+
+class UploadCallback : public IUploadFileCallback {
+ public:
+  UploadCallback(IUploadFileCallback::Pointer callback,
+                     std::function<void()> finished)
+      : callback_(callback), finished_(finished) {}
+
+  void reset() override { callback_->reset(); }
+
+  uint32_t putData(char* data, uint32_t maxlength) override {
+    return callback_->putData(data, maxlength);
+  }
+
+  uint64_t size() override { return callback_->size(); }
+
+  void done(EitherError<void> e) override {
+    finished_();
+    callback_->done(e);
+  }
+
+  void progress(uint32_t total, uint32_t now) override {
+    callback_->progress(total, now);
+  }
+
+ private:
+  IUploadFileCallback::Pointer callback_;
+  std::function<void()> finished_;
+};
+
+std::string listingKey(const std::string& id) { return "l" + id; }
+
+std::string itemKey(const std::string& id) { return "i" + id; }
+
+/**
+ * Aborts finished refresh, so that its wrapper doesn't wait for the request
+ * when destroyed by the request's own callback.
+ */
+void abortRefresh(IGenericRequest* request) {
+  using ListingWrapper = Request<EitherError<ItemList>>::Wrapper;
+  using ItemWrapper = Request<EitherError<IItem>>::Wrapper;
+  if (auto listing = dynamic_cast<ListingWrapper*>(request))
+    listing->abort();
+  else if (auto item = dynamic_cast<ItemWrapper*>(request))
+    item->abort();
+}
+
+}  // namespace
+
+CachedCloudProvider::CachedCloudProvider(CloudProvider::Pointer provider,
+                                         MetadataCache::Config config)
+    : provider_(provider) {
+  std::weak_ptr<CloudProvider> weak = provider;
+  config.restore_ = [weak](Item& item) {
+    if (auto p = weak.lock()) p->restoreItem(item);
+  };
+  cache_ = std::make_shared<MetadataCache>(config);
+}
+
+CloudProvider::Pointer CachedCloudProvider::provider() const {
+  return provider_;
+}
+
+MetadataCache::Statistics CachedCloudProvider::statistics() const {
+  return cache_->statistics();
+}
+
+std::string CachedCloudProvider::token() const { return provider_->token(); }
+
+ICloudProvider::Hints CachedCloudProvider::hints() const {
+  return provider_->hints();
+}
+
+std::string CachedCloudProvider::name() const { return provider_->name(); }
+
+std::string CachedCloudProvider::endpoint() const {
+  return provider_->endpoint();
+}
+
+std::string CachedCloudProvider::authorizeLibraryUrl() const {
+  return provider_->authorizeLibraryUrl();
+}
+
+IItem::Pointer CachedCloudProvider::rootDirectory() const {
+  return provider_->rootDirectory();
+}
+
+ICloudProvider::ExchangeCodeRequest::Pointer
+CachedCloudProvider::exchangeCodeAsync(const std::string& code,
+                                       ExchangeCodeCallback callback) {
+  return provider_->exchangeCodeAsync(code, callback);
+}
+
+ICloudProvider::ListDirectoryRequest::Pointer
+CachedCloudProvider::listDirectoryAsync(
+    IItem::Pointer item, IListDirectoryCallback::Pointer callback) {
+  ItemList items;
+  auto state = cache_->getListing(item->id(), items);
+  if (state == MetadataCache::State::Missing)
+    return provider_->listDirectoryAsync(
+        item, std::make_shared<ListCallback>(cache_, item->id(),
+                                             cache_->generation(), callback));
+  if (state == MetadataCache::State::Stale) {
+    std::weak_ptr<CachedCloudProvider> self = shared_from_this();
+    auto key = listingKey(item->id());
+    auto generation = cache_->generation();
+    refresh(key, [=]() {
+      return provider_->listDirectoryAsync(
+          item, std::make_shared<ListCallback>(
+                    cache_, item->id(), generation, nullptr, [=]() {
+                      if (auto provider = self.lock())
+                        provider->refreshed(key);
+                    }));
+    });
+  }
+  auto r = std::make_shared<Request<EitherError<ItemList>>>(provider_);
+  r->set([=](Request<EitherError<ItemList>>::Pointer r) {
+    for (const auto& i : items) callback->receivedItem(i);
+    callback->done(items);
+    r->done(items);
+  });
+  return r->run();
+}
+
+ICloudProvider::GetItemRequest::Pointer CachedCloudProvider::getItemAsync(
+    const std::string& absolute_path, GetItemCallback callback) {
+  return provider_->getItemAsync(absolute_path, callback);
+}
+
+ICloudProvider::DownloadFileRequest::Pointer
+CachedCloudProvider::downloadFileAsync(IItem::Pointer item,
+                                       IDownloadFileCallback::Pointer callback,
+                                       Range range) {
+  return provider_->downloadFileAsync(item, callback, range);
+}
+
+ICloudProvider::UploadFileRequest::Pointer CachedCloudProvider::uploadFileAsync(
+    IItem::Pointer parent, const std::string& filename,
+    IUploadFileCallback::Pointer callback) {
+  auto cache = cache_;
+  auto id = parent->id();
+  return provider_->uploadFileAsync(
+      parent, filename,
+      std::make_shared<UploadCallback>(callback,
+                                       [=]() { cache->changed(id); }));
+}
+
+ICloudProvider::GetItemDataRequest::Pointer
+CachedCloudProvider::getItemDataAsync(const std::string& id,
+                                      GetItemDataCallback callback) {
+  IItem::Pointer item;
+  auto state = cache_->getItem(id, item);
+  auto cache = cache_;
+  auto generation = cache_->generation();
+  if (state == MetadataCache::State::Missing)
+    return provider_->getItemDataAsync(id, [=](EitherError<IItem> e) {
+      if (e.right()) cache->putItem(e.right(), generation);
+      callback(e);
+    });
+  if (state == MetadataCache::State::Stale) {
+    std::weak_ptr<CachedCloudProvider> self = shared_from_this();
+    auto key = itemKey(id);
+    refresh(key, [=]() {
+      return provider_->getItemDataAsync(id, [=](EitherError<IItem> e) {
+        if (e.right()) cache->putItem(e.right(), generation);
+        if (auto provider = self.lock()) provider->refreshed(key);
+      });
+    });
+  }
+  auto r = std::make_shared<Request<EitherError<IItem>>>(provider_);
+  r->set([=](Request<EitherError<IItem>>::Pointer r) {
+    callback(item);
+    r->done(item);
+  });
+  return r->run();
+}
+
+ICloudProvider::DownloadFileRequest::Pointer
+CachedCloudProvider::getThumbnailAsync(
+    IItem::Pointer item, IDownloadFileCallback::Pointer callback) {
+  return provider_->getThumbnailAsync(item, callback);
+}
+
+ICloudProvider::DeleteItemRequest::Pointer CachedCloudProvider::deleteItemAsync(
+    IItem::Pointer item, DeleteItemCallback callback) {
+  auto cache = cache_;
+  auto id = item->id();
+  auto parents = provider_->parentIds(*item);
+  return provider_->deleteItemAsync(item, [=](EitherError<void> e) {
+    cache->remove(id, parents);
+    callback(e);
+  });
+}
+
+ICloudProvider::CreateDirectoryRequest::Pointer
+CachedCloudProvider::createDirectoryAsync(IItem::Pointer parent,
+                                          const std::string& name,
+                                          CreateDirectoryCallback callback) {
+  auto cache = cache_;
+  auto id = parent->id();
+  return provider_->createDirectoryAsync(
+      parent, name, [=](EitherError<IItem> e) {
+        cache->changed(id);
+        callback(e);
+      });
+}
+
+ICloudProvider::MoveItemRequest::Pointer CachedCloudProvider::moveItemAsync(
+    IItem::Pointer source, IItem::Pointer destination,
+    MoveItemCallback callback) {
+  auto cache = cache_;
+  auto source_id = source->id(), destination_id = destination->id();
+  auto parents = provider_->parentIds(*source);
+  return provider_->moveItemAsync(
+      source, destination, [=](EitherError<void> e) {
+        cache->remove(source_id, parents);
+        cache->changed(destination_id);
+        callback(e);
+      });
+}
+
+ICloudProvider::RenameItemRequest::Pointer CachedCloudProvider::renameItemAsync(
+    IItem::Pointer item, const std::string& name,
+    RenameItemCallback callback) {
+  auto cache = cache_;
+  auto id = item->id();
+  auto parents = provider_->parentIds(*item);
+  return provider_->renameItemAsync(item, name, [=](EitherError<void> e) {
+    cache->remove(id, parents);
+    callback(e);
+  });
+}
+
+ICloudProvider::ListDirectoryPageRequest::Pointer
+CachedCloudProvider::listDirectoryPageAsync(
+    IItem::Pointer item, const std::string& token,
+    ListDirectoryPageCallback callback) {
+  return provider_->listDirectoryPageAsync(item, token, callback);
+}
+
+ICloudProvider::WalkTreeRequest::Pointer CachedCloudProvider::walkTreeAsync(
+    IItem::Pointer directory, IWalkTreeCallback::Pointer callback,
+    uint32_t parallel, uint32_t max_depth) {
+  return provider_->walkTreeAsync(directory, callback, parallel, max_depth);
+}
+
+ICloudProvider::ListDirectoryRequest::Pointer
+CachedCloudProvider::listDirectoryAsync(IItem::Pointer item,
+                                        ListDirectoryCallback callback) {
+  return listDirectoryAsync(item,
+                            std::make_shared<SimpleListCallback>(callback));
+}
+
+ICloudProvider::DownloadFileRequest::Pointer
+CachedCloudProvider::downloadFileAsync(IItem::Pointer item,
+                                       const std::string& filename,
+                                       DownloadFileCallback callback) {
+  return provider_->downloadFileAsync(item, filename, callback);
+}
+
+ICloudProvider::DownloadFileRequest::Pointer
+CachedCloudProvider::getThumbnailAsync(IItem::Pointer item,
+                                       const std::string& filename,
+                                       GetThumbnailCallback callback) {
+  return provider_->getThumbnailAsync(item, filename, callback);
+}
+
+ICloudProvider::UploadFileRequest::Pointer CachedCloudProvider::uploadFileAsync(
+    IItem::Pointer parent, const std::string& path,
+    const std::string& filename, UploadFileCallback callback) {
+  auto cache = cache_;
+  auto id = parent->id();
+  return provider_->uploadFileAsync(parent, path, filename,
+                                    [=](EitherError<void> e) {
+                                      cache->changed(id);
+                                      callback(e);
+                                    });
+}
+
+void CachedCloudProvider::refresh(
+    const std::string& key,
+    std::function<std::shared_ptr<IGenericRequest>()> start) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (refreshing_.find(key) != refreshing_.end()) return;
+    refreshing_[key] = nullptr;
+  }
+  auto request = start();
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = refreshing_.find(key);
+  if (it != refreshing_.end()) it->second = request;
+}
+
+void CachedCloudProvider::refreshed(const std::string& key) {
+  std::shared_ptr<IGenericRequest> request;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = refreshing_.find(key);
+    if (it == refreshing_.end()) return;
+    request = std::move(it->second);
+    refreshing_.erase(it);
+  }
+  if (request) abortRefresh(request.get());
+}
+
+}  // namespace cloudstorage
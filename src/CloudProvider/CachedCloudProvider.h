@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * CachedCloudProvider.h : CachedCloudProvider headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef CACHEDCLOUDPROVIDER_H
+#define CACHEDCLOUDPROVIDER_H
+
+#include <map>
+
+#include "CloudProvider.h"
+#include "Utility/MetadataCache.h"
+
+namespace cloudstorage {
+
+/**
+ * Wraps cloud provider, serving directory listings and items' metadata from
+ * MetadataCache. Stale entries are returned right away while they're fetched
+ * again in background; entries affected by delete, create, move, rename and
+ * upload requests done through this object are forgotten once the request
+ * finishes. Created by ICloudStorage::provider when metadata_cache hint is
+ * "true".
+ */
+class CachedCloudProvider
+    : public ICloudProvider,
+      public std::enable_shared_from_this<CachedCloudProvider> {
+ public:
+  using Pointer = std::shared_ptr<CachedCloudProvider>;
+
+  CachedCloudProvider(CloudProvider::Pointer,
+                      MetadataCache::Config = MetadataCache::Config());
+
+  CloudProvider::Pointer provider() const;
+  MetadataCache::Statistics statistics() const;
+
+  std::string token() const override;
+  Hints hints() const override;
+  std::string name() const override;
+  std::string endpoint() const override;
+  std::string authorizeLibraryUrl() const override;
+  IItem::Pointer rootDirectory() const override;
+
+  ExchangeCodeRequest::Pointer exchangeCodeAsync(
+      const std::string&, ExchangeCodeCallback) override;
+  ListDirectoryRequest::Pointer listDirectoryAsync(
+      IItem::Pointer, IListDirectoryCallback::Pointer) override;
+  GetItemRequest::Pointer getItemAsync(const std::string& absolute_path,
+                                       GetItemCallback) override;
+  DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer,
+                                                 IDownloadFileCallback::Pointer,
+                                                 Range) override;
+  UploadFileRequest::Pointer uploadFileAsync(
+      IItem::Pointer parent, const std::string& filename,
+      IUploadFileCallback::Pointer) override;
+  GetItemDataRequest::Pointer getItemDataAsync(const std::string& id,
+                                               GetItemDataCallback) override;
+  DownloadFileRequest::Pointer getThumbnailAsync(
+      IItem::Pointer item, IDownloadFileCallback::Pointer) override;
+  DeleteItemRequest::Pointer deleteItemAsync(IItem::Pointer,
+                                             DeleteItemCallback) override;
+  CreateDirectoryRequest::Pointer createDirectoryAsync(
+      IItem::Pointer parent, const std::string& name,
+      CreateDirectoryCallback) override;
+  MoveItemRequest::Pointer moveItemAsync(IItem::Pointer source,
+                                         IItem::Pointer destination,
+                                         MoveItemCallback) override;
+  RenameItemRequest::Pointer renameItemAsync(IItem::Pointer item,
+                                             const std::string& name,
+                                             RenameItemCallback) override;
+  ListDirectoryPageRequest::Pointer listDirectoryPageAsync(
+      IItem::Pointer item, const std::string&,
+      ListDirectoryPageCallback) override;
+  WalkTreeRequest::Pointer walkTreeAsync(IItem::Pointer directory,
+                                         IWalkTreeCallback::Pointer,
+                                         uint32_t parallel,
+                                         uint32_t max_depth) override;
+
+  ListDirectoryRequest::Pointer listDirectoryAsync(
+      IItem::Pointer item, ListDirectoryCallback) override;
+  DownloadFileRequest::Pointer downloadFileAsync(
+      IItem::Pointer item, const std::string& filename,
+      DownloadFileCallback) override;
+  DownloadFileRequest::Pointer getThumbnailAsync(
+      IItem::Pointer item, const std::string& filename,
+      GetThumbnailCallback) override;
+  UploadFileRequest::Pointer uploadFileAsync(
+      IItem::Pointer parent, const std::string& path,
+      const std::string& filename, UploadFileCallback) override;
+
+ private:
+  /**
+   * Starts request fetching stale entry again, unless there is one already
+   * running for the key; the request has to call refreshed once it's done.
+   */
+  void refresh(const std::string& key,
+               std::function<std::shared_ptr<IGenericRequest>()> start);
+  void refreshed(const std::string& key);
+
+  CloudProvider::Pointer provider_;
+  MetadataCache::Pointer cache_;
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<IGenericRequest>> refreshing_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // CACHEDCLOUDPROVIDER_H
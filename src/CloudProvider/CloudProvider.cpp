@@ -24,11 +24,17 @@
 #include "CloudProvider.h"
 
 #include <json/json.h>
+#include <algorithm>
+#include <cctype>
 #include <cstring>
+#include <ctime>
 #include <fstream>
+#include <iomanip>
+#include <random>
 #include <sstream>
 
 #include "Utility/Item.h"
+#include "Utility/JsonParser.h"
 #include "Utility/Utility.h"
 
 #include "Request/CreateDirectoryRequest.h"
@@ -41,7 +47,9 @@
 #include "Request/ListDirectoryRequest.h"
 #include "Request/MoveItemRequest.h"
 #include "Request/RenameItemRequest.h"
+#include "Request/SegmentedDownloadRequest.h"
 #include "Request/UploadFileRequest.h"
+#include "Request/WalkTreeRequest.h"
 
 #ifdef WITH_CRYPTOPP
 #include "Utility/CryptoPP.h"
@@ -59,8 +67,55 @@ using namespace std::placeholders;
 
 const std::string DEFAULT_STATE = "DEFAULT_STATE";
 
+const uint32_t RETRY_MAX_ATTEMPTS = 5;
+const uint32_t RETRY_BASE_DELAY = 500;
+const uint32_t RETRY_MAX_DELAY = 60000;
+const uint64_t DOWNLOAD_SEGMENT_SIZE = 8 * 1024 * 1024;
+const uint32_t PARSE_CHUNK_SIZE = 16 * 1024;
+
+// CurlHttp reports curl errors negated; these happen before any part of the
+// response is received, so the request can be safely sent again.
+const std::vector<int> CONNECTION_ERRORS = {
+    -6 /* CURLE_COULDNT_RESOLVE_HOST */, -7 /* CURLE_COULDNT_CONNECT */,
+    -35 /* CURLE_SSL_CONNECT_ERROR */, -52 /* CURLE_GOT_NOTHING */};
+
+const std::vector<std::string> IDEMPOTENT_METHODS = {
+    "GET", "HEAD", "PUT", "DELETE", "OPTIONS", "PROPFIND"};
+
 namespace {
 
+int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+/**
+ * Parses Retry-After header, which is either count of seconds or http date.
+ *
+ * @return delay or negative duration if the header is invalid
+ */
+std::chrono::milliseconds parse_retry_after(const std::string& value) {
+  if (!value.empty() && std::all_of(value.begin(), value.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c));
+      }))
+    return std::chrono::seconds(std::atoll(value.c_str()));
+  std::tm tm = {};
+  std::istringstream stream(value);
+  stream >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+  if (stream.fail()) return std::chrono::milliseconds(-1);
+  int64_t time = days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) *
+                     86400 +
+                 tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+  int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  return std::chrono::seconds(std::max<int64_t>(0, time - now));
+}
+
 class ListDirectoryCallback : public cloudstorage::IListDirectoryCallback {
  public:
   ListDirectoryCallback(cloudstorage::ListDirectoryCallback callback)
@@ -133,18 +188,94 @@ class UploadFileCallback : public cloudstorage::IUploadFileCallback {
   uint64_t size_;
 };
 
+class JsonListParser
+    : public cloudstorage::CloudProvider::ListDirectoryParser {
+ public:
+  using JsonView = cloudstorage::util::JsonView;
+  using ToItem = std::function<cloudstorage::IItem::Pointer(const JsonView&)>;
+  using PageDone = std::function<void(const Json::Value& response,
+                                      std::string& next_page_token)>;
+
+  JsonListParser(const std::string& items_path, ToItem to_item,
+                 ItemReceived received, PageDone page_done)
+      : items_path_(items_path),
+        to_item_(to_item),
+        received_(received),
+        page_done_(page_done),
+        parser_(expanded(items_path),
+                std::bind(&JsonListParser::value, this, _1, _2)) {}
+
+  void write(const char* data, size_t length) override {
+    parser_.write(data, length);
+  }
+
+  bool finish(std::string& next_page_token) override {
+    if (!parser_.finish()) return false;
+    try {
+      page_done_(response_, next_page_token);
+      return true;
+    } catch (const std::exception&) {
+      return false;
+    }
+  }
+
+ private:
+  static std::vector<std::string> expanded(const std::string& items_path) {
+    std::vector<std::string> result = {""};
+    for (size_t i = items_path.find('/'); i != std::string::npos;
+         i = items_path.find('/', i + 1))
+      result.push_back(items_path.substr(0, i));
+    result.push_back(items_path);
+    return result;
+  }
+
+  void value(const std::string& path, const JsonView& value) {
+    if (path == items_path_) return received_(to_item_(value));
+    auto parent = &response_;
+    size_t begin = 0;
+    for (size_t end = path.find('/'); end != std::string::npos;
+         end = path.find('/', begin)) {
+      parent = &(*parent)[path.substr(begin, end - begin)];
+      begin = end + 1;
+    }
+    (*parent)[path.substr(begin)] = value.toValue();
+  }
+
+  std::string items_path_;
+  ToItem to_item_;
+  ItemReceived received_;
+  PageDone page_done_;
+  Json::Value response_;
+  cloudstorage::util::JsonParser parser_;
+};
+
 }  // namespace
 
 namespace cloudstorage {
 
+CloudProvider::RetryPolicy::RetryPolicy()
+    : max_attempts_(RETRY_MAX_ATTEMPTS),
+      base_delay_(RETRY_BASE_DELAY),
+      max_delay_(RETRY_MAX_DELAY) {}
+
 CloudProvider::CloudProvider(IAuth::Pointer auth)
-    : auth_(std::move(auth)), http_() {}
+    : auth_(std::move(auth)),
+      http_(),
+      admission_(std::make_shared<AdmissionController>()),
+      path_cache_(std::make_shared<PathCache>()),
+      download_segments_(1),
+      download_segment_size_(DOWNLOAD_SEGMENT_SIZE),
+      download_checkpoint_(false) {}
 
 void CloudProvider::initialize(InitData&& data) {
   auto lock = auth_lock();
   callback_ = std::move(data.callback_);
   crypto_ = std::move(data.crypto_engine_);
   http_ = std::move(data.http_engine_);
+  admission_ = std::make_shared<AdmissionController>(
+      AdmissionController::Config::fromHints(data.hints_));
+  path_cache_ =
+      std::make_shared<PathCache>(PathCache::Config::fromHints(data.hints_));
   http_server_ = std::move(data.http_server_);
 
   auto t = auth()->fromTokenString(data.token_);
@@ -166,13 +297,36 @@ void CloudProvider::initialize(InitData&& data) {
               [this](std::string v) { auth()->set_success_page(v); });
   setWithHint(data.hints_, "error_page",
               [this](std::string v) { auth()->set_error_page(v); });
+  setWithHint(data.hints_, "retry_max_attempts", [this](std::string v) {
+    retry_policy_.max_attempts_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "retry_base_delay", [this](std::string v) {
+    retry_policy_.base_delay_ =
+        std::chrono::milliseconds(std::atoll(v.c_str()));
+  });
+  setWithHint(data.hints_, "retry_max_delay", [this](std::string v) {
+    retry_policy_.max_delay_ =
+        std::chrono::milliseconds(std::atoll(v.c_str()));
+  });
+  setWithHint(data.hints_, "download_segments", [this](std::string v) {
+    download_segments_ = std::max(1, std::atoi(v.c_str()));
+  });
+  setWithHint(data.hints_, "download_segment_size", [this](std::string v) {
+    if (std::atoll(v.c_str()) > 0)
+      download_segment_size_ = std::atoll(v.c_str());
+  });
+  setWithHint(data.hints_, "download_checkpoint", [this](std::string v) {
+    download_checkpoint_ = v == "true";
+  });
 
 #ifdef WITH_CRYPTOPP
   if (!crypto_) crypto_ = util::make_unique<CryptoPP>();
 #endif
 
 #ifdef WITH_CURL
-  if (!http_) http_ = util::make_unique<curl::CurlHttp>();
+  if (!http_)
+    http_ = util::make_unique<curl::CurlHttp>(
+        curl::CurlHttp::Config::fromHints(data.hints_));
 #endif
 
 #ifdef WITH_MICROHTTPD
@@ -259,6 +413,12 @@ ICrypto* CloudProvider::crypto() const { return crypto_.get(); }
 
 IHttp* CloudProvider::http() const { return http_.get(); }
 
+AdmissionController::Pointer CloudProvider::admission() const {
+  return admission_;
+}
+
+PathCache::Pointer CloudProvider::path_cache() const { return path_cache_; }
+
 IHttpServerFactory* CloudProvider::http_server() const {
   return http_server_.get();
 }
@@ -279,6 +439,10 @@ ICloudProvider::ListDirectoryRequest::Pointer CloudProvider::listDirectoryAsync(
 
 ICloudProvider::GetItemRequest::Pointer CloudProvider::getItemAsync(
     const std::string& absolute_path, GetItemCallback callback) {
+  auto path = absolute_path;
+  if (path.size() > 1 && path.back() == '/') path.pop_back();
+  auto id = path.size() > 1 && path.front() == '/' ? pathToId(path) : "";
+  if (!id.empty()) return getItemDataAsync(id, callback);
   return std::make_shared<cloudstorage::GetItemRequest>(shared_from_this(),
                                                         absolute_path, callback)
       ->run();
@@ -286,6 +450,17 @@ ICloudProvider::GetItemRequest::Pointer CloudProvider::getItemAsync(
 
 ICloudProvider::DownloadFileRequest::Pointer CloudProvider::downloadFileAsync(
     IItem::Pointer file, IDownloadFileCallback::Pointer callback, Range range) {
+  uint64_t size = range.size_;
+  if (size == Range::Full && file->size() != IItem::UnknownSize)
+    size = file->size() - std::min<uint64_t>(range.start_, file->size());
+  if (segmentedDownload() && download_segments_ > 1 && size != Range::Full &&
+      size > download_segment_size_)
+    return std::make_shared<SegmentedDownloadRequest>(
+               shared_from_this(), std::move(file), std::move(callback), range,
+               std::bind(&CloudProvider::downloadFileRequest, this, _1, _2),
+               SegmentedDownloadRequest::Parameters{
+                   download_segments_, download_segment_size_, false})
+        ->run();
   return std::make_shared<cloudstorage::DownloadFileRequest>(
              shared_from_this(), std::move(file), std::move(callback), range,
              std::bind(&CloudProvider::downloadFileRequest, this, _1, _2))
@@ -316,6 +491,50 @@ bool CloudProvider::reauthorize(int code) const {
   return IHttpRequest::isAuthorizationError(code);
 }
 
+bool CloudProvider::isRetryable(int code, const std::string& method) const {
+  if (code == IHttpRequest::TooManyRequests) return true;
+  if (std::find(IDEMPOTENT_METHODS.begin(), IDEMPOTENT_METHODS.end(),
+                method) == IDEMPOTENT_METHODS.end())
+    return false;
+  return code == IHttpRequest::InternalServerError ||
+         code == IHttpRequest::BadGateway ||
+         code == IHttpRequest::ServiceUnavailable ||
+         code == IHttpRequest::GatewayTimeout ||
+         std::find(CONNECTION_ERRORS.begin(), CONNECTION_ERRORS.end(), code) !=
+             CONNECTION_ERRORS.end();
+}
+
+std::chrono::milliseconds CloudProvider::retryDelay(
+    const IHttpRequest::Response& response, const std::string& method,
+    uint32_t attempt) const {
+  const std::chrono::milliseconds invalid(-1);
+  if (attempt + 1 >= retry_policy_.max_attempts_ ||
+      !isRetryable(response.http_code_, method))
+    return invalid;
+  auto it = response.headers_.find("retry-after");
+  if (it != response.headers_.end()) {
+    auto delay = parse_retry_after(it->second);
+    if (delay > retry_policy_.max_delay_) return invalid;
+    if (delay >= std::chrono::milliseconds::zero()) return delay;
+  }
+  thread_local std::default_random_engine engine{std::random_device()()};
+  int64_t max = retry_policy_.base_delay_.count()
+                << std::min<uint32_t>(attempt, 20);
+  max = std::min<int64_t>(max, retry_policy_.max_delay_.count());
+  return std::chrono::milliseconds(
+      std::uniform_int_distribution<int64_t>(0, max)(engine));
+}
+
+const CloudProvider::RetryPolicy& CloudProvider::retry_policy() const {
+  return retry_policy_;
+}
+
+Timer* CloudProvider::timer() {
+  std::lock_guard<std::mutex> lock(timer_mutex_);
+  if (!timer_) timer_ = util::make_unique<Timer>();
+  return timer_.get();
+}
+
 bool CloudProvider::unpackCredentials(const std::string&) { return false; }
 
 AuthorizeRequest::Pointer CloudProvider::authorizeAsync() {
@@ -333,6 +552,13 @@ void CloudProvider::setWithHint(const ICloudProvider::Hints& hints,
   if (it != hints.end()) f(it->second);
 }
 
+std::vector<std::string> CloudProvider::parentIds(const IItem& item) const {
+  auto i = dynamic_cast<const Item*>(&item);
+  return i ? i->parents() : std::vector<std::string>();
+}
+
+void CloudProvider::restoreItem(Item&) const {}
+
 std::string CloudProvider::getPath(const std::string& p) {
   std::string result = p;
   if (result.back() == '/') result.pop_back();
@@ -356,16 +582,18 @@ std::pair<std::string, std::string> CloudProvider::credentialsFromString(
 
 ICloudProvider::DownloadFileRequest::Pointer CloudProvider::getThumbnailAsync(
     IItem::Pointer item, IDownloadFileCallback::Pointer callback) {
-  return std::make_shared<cloudstorage::DownloadFileRequest>(
-             shared_from_this(), item, std::move(callback), FullRange,
-             std::bind(&CloudProvider::getThumbnailRequest, this, _1, _2))
-      ->run();
+  auto r = std::make_shared<cloudstorage::DownloadFileRequest>(
+      shared_from_this(), item, std::move(callback), FullRange,
+      std::bind(&CloudProvider::getThumbnailRequest, this, _1, _2));
+  r->set_priority(IHttpRequest::Priority::Normal);
+  return r->run();
 }
 
 ICloudProvider::DeleteItemRequest::Pointer CloudProvider::deleteItemAsync(
     IItem::Pointer item, DeleteItemCallback callback) {
-  return std::make_shared<cloudstorage::DeleteItemRequest>(shared_from_this(),
-                                                           item, callback)
+  return std::make_shared<cloudstorage::DeleteItemRequest>(
+             shared_from_this(), item,
+             invalidatePaths(item, nullptr, callback))
       ->run();
 }
 
@@ -374,7 +602,8 @@ CloudProvider::createDirectoryAsync(IItem::Pointer parent,
                                     const std::string& name,
                                     CreateDirectoryCallback callback) {
   return std::make_shared<cloudstorage::CreateDirectoryRequest>(
-             shared_from_this(), parent, name, callback)
+             shared_from_this(), parent, name,
+             invalidatePaths(nullptr, parent, callback))
       ->run();
 }
 
@@ -382,14 +611,16 @@ ICloudProvider::MoveItemRequest::Pointer CloudProvider::moveItemAsync(
     IItem::Pointer source, IItem::Pointer destination,
     MoveItemCallback callback) {
   return std::make_shared<cloudstorage::MoveItemRequest>(
-             shared_from_this(), source, destination, callback)
+             shared_from_this(), source, destination,
+             invalidatePaths(source, destination, callback))
       ->run();
 }
 
 ICloudProvider::RenameItemRequest::Pointer CloudProvider::renameItemAsync(
     IItem::Pointer item, const std::string& name, RenameItemCallback callback) {
-  return std::make_shared<cloudstorage::RenameItemRequest>(shared_from_this(),
-                                                           item, name, callback)
+  return std::make_shared<cloudstorage::RenameItemRequest>(
+             shared_from_this(), item, name,
+             invalidatePaths(item, nullptr, callback))
       ->run();
 }
 
@@ -402,6 +633,15 @@ CloudProvider::listDirectoryPageAsync(IItem::Pointer directory,
       ->run();
 }
 
+ICloudProvider::WalkTreeRequest::Pointer CloudProvider::walkTreeAsync(
+    IItem::Pointer directory, IWalkTreeCallback::Pointer callback,
+    uint32_t parallel, uint32_t max_depth) {
+  return std::make_shared<cloudstorage::WalkTreeRequest>(
+             shared_from_this(), std::move(directory), std::move(callback),
+             parallel, max_depth)
+      ->run();
+}
+
 ICloudProvider::ListDirectoryRequest::Pointer CloudProvider::listDirectoryAsync(
     IItem::Pointer item, ListDirectoryCallback callback) {
   return listDirectoryAsync(
@@ -411,6 +651,18 @@ ICloudProvider::ListDirectoryRequest::Pointer CloudProvider::listDirectoryAsync(
 ICloudProvider::DownloadFileRequest::Pointer CloudProvider::downloadFileAsync(
     IItem::Pointer item, const std::string& filename,
     DownloadFileCallback callback) {
+#ifndef _WIN32
+  if (segmentedDownload() && item->size() != IItem::UnknownSize &&
+      (download_checkpoint_ ||
+       (download_segments_ > 1 && item->size() > download_segment_size_)))
+    return std::make_shared<SegmentedDownloadRequest>(
+               shared_from_this(), item, filename, callback,
+               std::bind(&CloudProvider::downloadFileRequest, this, _1, _2),
+               SegmentedDownloadRequest::Parameters{download_segments_,
+                                                    download_segment_size_,
+                                                    download_checkpoint_})
+        ->run();
+#endif
   return downloadFileAsync(
       item, util::make_unique<::DownloadFileCallback>(filename, callback),
       FullRange);
@@ -431,6 +683,10 @@ ICloudProvider::UploadFileRequest::Pointer CloudProvider::uploadFileAsync(
       util::make_unique<::UploadFileCallback>(path, callback));
 }
 
+bool CloudProvider::segmentedDownload() const { return true; }
+
+std::string CloudProvider::pathToId(const std::string&) const { return ""; }
+
 IHttpRequest::Pointer CloudProvider::getItemDataRequest(const std::string&,
                                                         std::ostream&) const {
   return nullptr;
@@ -491,6 +747,36 @@ std::vector<IItem::Pointer> CloudProvider::listDirectoryResponse(
   return {};
 }
 
+CloudProvider::ListDirectoryParser::Pointer CloudProvider::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived) const {
+  return nullptr;
+}
+
+CloudProvider::ListDirectoryParser::Pointer CloudProvider::jsonListParser(
+    const std::string& items_path,
+    std::function<IItem::Pointer(const util::JsonView&)> to_item,
+    ListDirectoryParser::ItemReceived received,
+    std::function<void(const Json::Value&, std::string&)> page_done) {
+  return std::make_shared<JsonListParser>(items_path, to_item, received,
+                                          page_done);
+}
+
+std::vector<IItem::Pointer> CloudProvider::parseListDirectory(
+    const IItem& directory, std::istream& response,
+    std::string& next_page_token) const {
+  std::vector<IItem::Pointer> result;
+  auto parser = listDirectoryParser(
+      directory, [&result](IItem::Pointer item) { result.push_back(item); });
+  if (!parser) return result;
+  char buffer[PARSE_CHUNK_SIZE];
+  std::streamsize read;
+  while ((read = response.rdbuf()->sgetn(buffer, PARSE_CHUNK_SIZE)) > 0)
+    parser->write(buffer, static_cast<size_t>(read));
+  if (!parser->finish(next_page_token))
+    throw std::logic_error("invalid directory listing");
+  return result;
+}
+
 IItem::Pointer CloudProvider::createDirectoryResponse(
     std::istream& stream) const {
   return getItemDataResponse(stream);
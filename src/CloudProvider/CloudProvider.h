@@ -24,21 +24,68 @@
 #ifndef CLOUDPROVIDER_H
 #define CLOUDPROVIDER_H
 
+#include <json/forwards.h>
 #include <mutex>
 #include <sstream>
 #include <thread>
 
 #include "ICloudProvider.h"
 #include "Request/AuthorizeRequest.h"
+#include "Utility/AdmissionController.h"
 #include "Utility/Auth.h"
+#include "Utility/JsonView.h"
+#include "Utility/PathCache.h"
+#include "Utility/Timer.h"
 
 namespace cloudstorage {
 
+class Item;
+
 class CloudProvider : public ICloudProvider,
                       public std::enable_shared_from_this<CloudProvider> {
  public:
   using Pointer = std::shared_ptr<CloudProvider>;
 
+  /**
+   * Describes how requests which failed with transient errors are repeated;
+   * delay before n-th retry is chosen at random from [0, base_delay_ * 2^n],
+   * capped at max_delay_.
+   */
+  struct RetryPolicy {
+    RetryPolicy();
+
+    uint32_t max_attempts_;
+    std::chrono::milliseconds base_delay_;
+    std::chrono::milliseconds max_delay_;
+  };
+
+  /**
+   * Extracts items from directory listing response while it's being
+   * downloaded.
+   */
+  class ListDirectoryParser {
+   public:
+    using Pointer = std::shared_ptr<ListDirectoryParser>;
+    using ItemReceived = std::function<void(IItem::Pointer)>;
+
+    virtual ~ListDirectoryParser() = default;
+
+    /**
+     * Parses next chunk of the response; it's called from http engine's
+     * callback, so it mustn't throw.
+     */
+    virtual void write(const char* data, size_t length) = 0;
+
+    /**
+     * Called once the whole response was written.
+     *
+     * @param next_page_token should be set to string describing the next page
+     * or to empty string if there is no next page
+     * @return whether the response was valid
+     */
+    virtual bool finish(std::string& next_page_token) = 0;
+  };
+
   CloudProvider(IAuth::Pointer);
 
   virtual void initialize(InitData&&);
@@ -52,11 +99,33 @@ class CloudProvider : public ICloudProvider,
   IItem::Pointer rootDirectory() const override;
   ICrypto* crypto() const;
   IHttp* http() const;
+
+  /**
+   * Limits count of concurrent http requests sent by Request::send.
+   */
+  AdmissionController::Pointer admission() const;
+
+  /**
+   * Listings done by getItemAsync, reused by its next calls.
+   */
+  PathCache::Pointer path_cache() const;
   IHttpServerFactory* http_server() const;
   IAuthCallback* auth_callback() const;
 
   virtual AuthorizeRequest::Pointer authorizeAsync();
 
+  /**
+   * Ids of directories containing the item which can be told from the item
+   * itself, by default its parents; used to invalidate cached listings.
+   */
+  virtual std::vector<std::string> parentIds(const IItem&) const;
+
+  /**
+   * Sets fields of item read from MetadataSnapshot which aren't saved there,
+   * does nothing by default.
+   */
+  virtual void restoreItem(Item&) const;
+
   ExchangeCodeRequest::Pointer exchangeCodeAsync(const std::string&,
                                                  ExchangeCodeCallback) override;
   ListDirectoryRequest::Pointer listDirectoryAsync(
@@ -86,6 +155,10 @@ class CloudProvider : public ICloudProvider,
                                              RenameItemCallback) override;
   ListDirectoryPageRequest::Pointer listDirectoryPageAsync(
       IItem::Pointer, const std::string&, ListDirectoryPageCallback) override;
+  WalkTreeRequest::Pointer walkTreeAsync(IItem::Pointer directory,
+                                         IWalkTreeCallback::Pointer,
+                                         uint32_t parallel,
+                                         uint32_t max_depth) override;
   ListDirectoryRequest::Pointer listDirectoryAsync(
       IItem::Pointer item, ListDirectoryCallback callback) override;
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer item,
@@ -99,6 +172,17 @@ class CloudProvider : public ICloudProvider,
                                              const std::string& filename,
                                              UploadFileCallback) override;
 
+  /**
+   * Used by default implementation of getItemAsync; providers which address
+   * items by path should translate the path to item's id, so that the item
+   * is fetched with a single getItemDataAsync. Default implementation returns
+   * empty string, which makes getItemAsync list every directory on the path.
+   *
+   * @param path absolute path without trailing slash, other than /
+   * @return item's id
+   */
+  virtual std::string pathToId(const std::string& path) const;
+
   /**
    * Used by default implementation of getItemDataAsync.
    *
@@ -142,6 +226,13 @@ class CloudProvider : public ICloudProvider,
   virtual IHttpRequest::Pointer downloadFileRequest(
       const IItem&, std::ostream& input_stream) const;
 
+  /**
+   * Whether downloadFileRequest with Range header can be used to download a
+   * file in segments; providers which implement downloadFileAsync on their
+   * own should return false.
+   */
+  virtual bool segmentedDownload() const;
+
   /**
    * Used by default implementation of getThumbnailAsync; tries to download
    * thumbnail from Item::thumnail_url.
@@ -217,6 +308,28 @@ class CloudProvider : public ICloudProvider,
       const IItem& directory, std::istream& response,
       std::string& next_page_token) const;
 
+  /**
+   * Used by default implementation of listDirectoryAsync; items found by the
+   * parser are reported right away, without waiting for the rest of the page.
+   * Returns nullptr by default, then the page is parsed with
+   * listDirectoryResponse once it's downloaded.
+   *
+   * @param directory
+   * @param received called with every item found in the response
+   * @return parser or nullptr
+   */
+  virtual ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem& directory, ListDirectoryParser::ItemReceived received) const;
+
+  /**
+   * Implements listDirectoryResponse with listDirectoryParser.
+   *
+   * @throw std::logic_error if the response is invalid
+   */
+  std::vector<IItem::Pointer> parseListDirectory(
+      const IItem& directory, std::istream& response,
+      std::string& next_page_token) const;
+
   /**
    * Used by default implementation of createDirectoryAsync, should translate
    * response into new directory's item object.
@@ -244,6 +357,33 @@ class CloudProvider : public ICloudProvider,
    */
   virtual bool reauthorize(int code) const;
 
+  /**
+   * Returns whether request which failed with http code / curl error may be
+   * sent again. By default 429 is retried for every method, 5xx codes and
+   * connection errors only for idempotent methods.
+   *
+   * @param code http code / curl error
+   * @param method http method of the request
+   * @return whether to retry the request
+   */
+  virtual bool isRetryable(int code, const std::string& method) const;
+
+  /**
+   * Computes the delay before sending again the request which got response;
+   * honors Retry-After header.
+   *
+   * @param response
+   * @param method http method of the request
+   * @param attempt count of attempts done so far
+   * @return delay or negative duration if the request shouldn't be retried
+   */
+  std::chrono::milliseconds retryDelay(const IHttpRequest::Response& response,
+                                       const std::string& method,
+                                       uint32_t attempt) const;
+
+  const RetryPolicy& retry_policy() const;
+  Timer* timer();
+
   virtual bool unpackCredentials(const std::string&);
 
   std::unique_lock<std::mutex> auth_lock() const;
@@ -257,6 +397,44 @@ class CloudProvider : public ICloudProvider,
   void setWithHint(const Hints& hints, const std::string& name,
                    std::function<void(std::string)>) const;
 
+  /**
+   * Creates listDirectoryParser for json responses whose entries are elements
+   * of array at items_path, e.g. "files" or "_embedded/items"; each of them
+   * is turned into item as soon as it's downloaded.
+   *
+   * @param to_item translates entry into item; entries are parsed with the
+   * configured json backend and are valid only during the call
+   * @param received called with every item
+   * @param page_done called with the rest of the response once it's parsed,
+   * should set next page token
+   */
+  static ListDirectoryParser::Pointer jsonListParser(
+      const std::string& items_path,
+      std::function<IItem::Pointer(const util::JsonView&)> to_item,
+      ListDirectoryParser::ItemReceived received,
+      std::function<void(const Json::Value& response,
+                         std::string& next_page_token)>
+          page_done);
+
+  /**
+   * Wraps callback of a request which deletes, moves, renames or creates
+   * items, so that path cache forgets listings changed by it once it's done.
+   *
+   * @param removed item which was deleted, moved or renamed, may be null
+   * @param changed directory whose contents changed, may be null
+   */
+  template <class T>
+  std::function<void(T)> invalidatePaths(IItem::Pointer removed,
+                                         IItem::Pointer changed,
+                                         std::function<void(T)> callback) {
+    auto cache = path_cache_;
+    return [=](T e) {
+      if (removed) cache->remove(*removed);
+      if (changed) cache->changed(*changed);
+      callback(std::move(e));
+    };
+  }
+
  private:
   friend class AuthorizeRequest;
   template <class T>
@@ -266,7 +444,15 @@ class CloudProvider : public ICloudProvider,
   IAuthCallback::Pointer callback_;
   ICrypto::Pointer crypto_;
   IHttp::Pointer http_;
+  AdmissionController::Pointer admission_;
+  PathCache::Pointer path_cache_;
   IHttpServerFactory::Pointer http_server_;
+  RetryPolicy retry_policy_;
+  uint32_t download_segments_;
+  uint64_t download_segment_size_;
+  bool download_checkpoint_;
+  Timer::Pointer timer_;
+  std::mutex timer_mutex_;
   AuthorizeRequest::Pointer current_authorization_;
   std::unordered_map<IGenericRequest*,
                      std::vector<AuthorizeRequest::AuthorizeCompleted>>
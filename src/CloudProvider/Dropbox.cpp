@@ -50,6 +50,8 @@ bool Dropbox::reauthorize(int code) const {
   return code == IHttpRequest::Bad || code == IHttpRequest::Unauthorized;
 }
 
+std::string Dropbox::pathToId(const std::string& path) const { return path; }
+
 ICloudProvider::GetItemDataRequest::Pointer Dropbox::getItemDataAsync(
     const std::string& id, GetItemDataCallback callback) {
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
@@ -230,16 +232,19 @@ IHttpRequest::Pointer Dropbox::renameItemRequest(const IItem& item,
 }
 
 std::vector<IItem::Pointer> Dropbox::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  Json::Value response;
-  stream >> response;
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
 
-  std::vector<IItem::Pointer> result;
-  for (const Json::Value& v : response["entries"]) result.push_back(toItem(v));
-  if (response["has_more"].asBool()) {
-    next_page_token = response["cursor"].asString();
-  }
-  return result;
+CloudProvider::ListDirectoryParser::Pointer Dropbox::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "entries", [=](const util::JsonView& v) { return toItem(v); }, received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        if (response["has_more"].asBool())
+          next_page_token = response["cursor"].asString();
+      });
 }
 
 IItem::Pointer Dropbox::createDirectoryResponse(std::istream& stream) const {
@@ -248,7 +253,7 @@ IItem::Pointer Dropbox::createDirectoryResponse(std::istream& stream) const {
   return toItem(response);
 }
 
-IItem::Pointer Dropbox::toItem(const Json::Value& v) {
+IItem::Pointer Dropbox::toItem(const util::JsonView& v) {
   IItem::FileType type = IItem::FileType::Unknown;
   if (v[".tag"].asString() == "folder")
     type = IItem::FileType::Directory;
@@ -39,6 +39,7 @@ class Dropbox : public CloudProvider {
   IItem::Pointer rootDirectory() const override;
   bool reauthorize(int code) const override;
 
+  std::string pathToId(const std::string& path) const override;
   GetItemDataRequest::Pointer getItemDataAsync(const std::string& id,
                                                GetItemDataCallback) override;
 
@@ -66,12 +67,14 @@ class Dropbox : public CloudProvider {
 
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
   IItem::Pointer createDirectoryResponse(std::istream&) const override;
 
   void authorizeRequest(IHttpRequest&) const override;
 
  private:
-  static IItem::Pointer toItem(const Json::Value&);
+  static IItem::Pointer toItem(const util::JsonView&);
 
   class Auth : public cloudstorage::Auth {
    public:
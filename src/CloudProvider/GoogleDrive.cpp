@@ -147,15 +147,19 @@ IItem::Pointer GoogleDrive::getItemDataResponse(std::istream& response) const {
 }
 
 std::vector<IItem::Pointer> GoogleDrive::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  Json::Value response;
-  stream >> response;
-  std::vector<IItem::Pointer> result;
-  for (Json::Value v : response["files"]) result.push_back(toItem(v));
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
 
-  if (response.isMember("nextPageToken"))
-    next_page_token = response["nextPageToken"].asString();
-  return result;
+CloudProvider::ListDirectoryParser::Pointer GoogleDrive::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "files", [=](const util::JsonView& v) { return toItem(v); }, received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        if (response.isMember("nextPageToken"))
+          next_page_token = response["nextPageToken"].asString();
+      });
 }
 
 bool GoogleDrive::isGoogleMimeType(const std::string& mime_type) const {
@@ -178,7 +182,7 @@ IItem::FileType GoogleDrive::toFileType(const std::string& mime_type) const {
     return Item::fromMimeType(mime_type);
 }
 
-IItem::Pointer GoogleDrive::toItem(const Json::Value& v) const {
+IItem::Pointer GoogleDrive::toItem(const util::JsonView& v) const {
   auto item = util::make_unique<Item>(
       v["name"].asString(), v["id"].asString(),
       v.isMember("size") ? std::atoll(v["size"].asString().c_str())
@@ -194,7 +198,7 @@ IItem::Pointer GoogleDrive::toItem(const Json::Value& v) const {
   item->set_url(endpoint() + "/drive/v3/files/" + item->id() +
                 "?alt=media&access_token=" + access_token());
   std::vector<std::string> parents;
-  for (auto id : v["parents"]) parents.push_back(id.asString());
+  for (auto id : v["parents"].elements()) parents.push_back(id.asString());
   item->set_parents(parents);
   return std::move(item);
 }
@@ -60,10 +60,12 @@ class GoogleDrive : public CloudProvider {
   IItem::Pointer getItemDataResponse(std::istream& response) const override;
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
 
   bool isGoogleMimeType(const std::string& mime_type) const;
   IItem::FileType toFileType(const std::string& mime_type) const;
-  IItem::Pointer toItem(const Json::Value&) const;
+  IItem::Pointer toItem(const util::JsonView&) const;
 
   class Auth : public cloudstorage::Auth {
    public:
@@ -519,6 +519,8 @@ AuthorizeRequest::Pointer MegaNz::authorizeAsync() {
       });
 }
 
+std::string MegaNz::pathToId(const std::string& path) const { return path; }
+
 ICloudProvider::GetItemDataRequest::Pointer MegaNz::getItemDataAsync(
     const std::string& id, GetItemDataCallback callback) {
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
@@ -570,6 +572,8 @@ ICloudProvider::ListDirectoryRequest::Pointer MegaNz::listDirectoryAsync(
   return r->run();
 }
 
+bool MegaNz::segmentedDownload() const { return false; }
+
 ICloudProvider::DownloadFileRequest::Pointer MegaNz::downloadFileAsync(
     IItem::Pointer item, IDownloadFileCallback::Pointer callback, Range range) {
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
@@ -667,6 +671,7 @@ ICloudProvider::DownloadFileRequest::Pointer MegaNz::getThumbnailAsync(
 
 ICloudProvider::DeleteItemRequest::Pointer MegaNz::deleteItemAsync(
     IItem::Pointer item, DeleteItemCallback callback) {
+  callback = invalidatePaths(item, nullptr, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
     ensureAuthorized<EitherError<void>>(r, callback, [=] {
@@ -694,6 +699,7 @@ ICloudProvider::DeleteItemRequest::Pointer MegaNz::deleteItemAsync(
 ICloudProvider::CreateDirectoryRequest::Pointer MegaNz::createDirectoryAsync(
     IItem::Pointer parent, const std::string& name,
     CreateDirectoryCallback callback) {
+  callback = invalidatePaths(nullptr, parent, callback);
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
   r->set([=](Request<EitherError<IItem>>::Pointer r) {
     ensureAuthorized<EitherError<IItem>>(r, callback, [=] {
@@ -727,6 +733,7 @@ ICloudProvider::CreateDirectoryRequest::Pointer MegaNz::createDirectoryAsync(
 ICloudProvider::MoveItemRequest::Pointer MegaNz::moveItemAsync(
     IItem::Pointer source, IItem::Pointer destination,
     MoveItemCallback callback) {
+  callback = invalidatePaths(source, destination, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
     ensureAuthorized<EitherError<void>>(r, callback, [=] {
@@ -756,6 +763,7 @@ ICloudProvider::MoveItemRequest::Pointer MegaNz::moveItemAsync(
 
 ICloudProvider::RenameItemRequest::Pointer MegaNz::renameItemAsync(
     IItem::Pointer item, const std::string& name, RenameItemCallback callback) {
+  callback = invalidatePaths(item, nullptr, callback);
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
   r->set([=](Request<EitherError<void>>::Pointer r) {
     ensureAuthorized<EitherError<void>>(r, callback, [=] {
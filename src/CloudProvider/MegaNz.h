@@ -68,6 +68,7 @@ class MegaNz : public CloudProvider {
   ExchangeCodeRequest::Pointer exchangeCodeAsync(const std::string&,
                                                  ExchangeCodeCallback) override;
   AuthorizeRequest::Pointer authorizeAsync() override;
+  std::string pathToId(const std::string& path) const override;
   GetItemDataRequest::Pointer getItemDataAsync(
       const std::string& id, GetItemDataCallback callback) override;
   ListDirectoryRequest::Pointer listDirectoryAsync(
@@ -75,6 +76,7 @@ class MegaNz : public CloudProvider {
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer,
                                                  IDownloadFileCallback::Pointer,
                                                  Range) override;
+  bool segmentedDownload() const override;
   UploadFileRequest::Pointer uploadFileAsync(
       IItem::Pointer, const std::string&,
       IUploadFileCallback::Pointer) override;
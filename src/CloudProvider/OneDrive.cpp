@@ -190,7 +190,7 @@ IItem::Pointer OneDrive::getItemDataResponse(std::istream& response) const {
   return toItem(json);
 }
 
-IItem::Pointer OneDrive::toItem(const Json::Value& v) const {
+IItem::Pointer OneDrive::toItem(const util::JsonView& v) const {
   IItem::FileType type = IItem::FileType::Unknown;
   if (v.isMember("folder"))
     type = IItem::FileType::Directory;
@@ -210,14 +210,19 @@ IItem::Pointer OneDrive::toItem(const Json::Value& v) const {
 }
 
 std::vector<IItem::Pointer> OneDrive::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  std::vector<IItem::Pointer> result;
-  Json::Value response;
-  stream >> response;
-  for (Json::Value v : response["value"]) result.push_back(toItem(v));
-  if (response.isMember("@odata.nextLink"))
-    next_page_token = response["@odata.nextLink"].asString();
-  return result;
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
+
+CloudProvider::ListDirectoryParser::Pointer OneDrive::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "value", [=](const util::JsonView& v) { return toItem(v); }, received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        if (response.isMember("@odata.nextLink"))
+          next_page_token = response["@odata.nextLink"].asString();
+      });
 }
 
 OneDrive::Auth::Auth() {
@@ -62,6 +62,8 @@ class OneDrive : public CloudProvider {
 
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string&) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
   IItem::Pointer getItemDataResponse(std::istream& response) const override;
 
  private:
@@ -81,7 +83,7 @@ class OneDrive : public CloudProvider {
     Token::Pointer refreshTokenResponse(std::istream&) const override;
   };
 
-  IItem::Pointer toItem(const Json::Value&) const;
+  IItem::Pointer toItem(const util::JsonView&) const;
 };
 
 }  // namespace cloudstorage
@@ -25,11 +25,61 @@
 
 #include "Request/AuthorizeRequest.h"
 #include "Utility/Item.h"
+#include "Utility/XmlParser.h"
 
 #include <cstring>
 
+using namespace std::placeholders;
+
 namespace cloudstorage {
 
+namespace {
+
+/**
+ * Parses multistatus response of PROPFIND request; reports href and content
+ * length of every response element as soon as it ends.
+ */
+class MultistatusParser : public CloudProvider::ListDirectoryParser {
+ public:
+  using Response =
+      std::function<void(const std::string& href, size_t content_length)>;
+
+  MultistatusParser(Response response)
+      : response_(response),
+        parser_(std::bind(&MultistatusParser::element, this, _1, _2)),
+        content_length_(IItem::UnknownSize) {}
+
+  void write(const char* data, size_t length) override {
+    parser_.write(data, length);
+  }
+
+  void write(std::istream& stream) { parser_.write(stream); }
+
+  bool finish(std::string&) override { return parser_.finish(); }
+
+ private:
+  void element(const std::vector<std::string>& path, const std::string& text) {
+    if (path.size() == 3 && path[1] == "d:response" && path[2] == "d:href") {
+      href_ = text;
+    } else if (path.size() == 5 && path[2] == "d:propstat" &&
+               path[3] == "d:prop" && path[4] == "d:getcontentlength") {
+      content_length_ = static_cast<size_t>(std::atoll(text.c_str()));
+    } else if (path.size() == 2 && path[1] == "d:response") {
+      if (href_.empty()) throw std::logic_error("invalid xml");
+      response_(href_, content_length_);
+      href_.clear();
+      content_length_ = IItem::UnknownSize;
+    }
+  }
+
+  Response response_;
+  util::XmlParser parser_;
+  std::string href_;
+  size_t content_length_;
+};
+
+}  // namespace
+
 OwnCloud::OwnCloud() : CloudProvider(util::make_unique<Auth>()) {}
 
 IItem::Pointer OwnCloud::rootDirectory() const {
@@ -58,6 +108,7 @@ AuthorizeRequest::Pointer OwnCloud::authorizeAsync() {
 ICloudProvider::CreateDirectoryRequest::Pointer OwnCloud::createDirectoryAsync(
     IItem::Pointer parent, const std::string& name,
     CreateDirectoryCallback callback) {
+  callback = invalidatePaths(nullptr, parent, callback);
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
   r->set([=](Request<EitherError<IItem>>::Pointer r) {
     auto response = std::make_shared<std::stringstream>();
@@ -84,6 +135,13 @@ ICloudProvider::CreateDirectoryRequest::Pointer OwnCloud::createDirectoryAsync(
   return r->run();
 }
 
+std::string OwnCloud::pathToId(const std::string& path) const {
+  std::string id, name;
+  std::stringstream stream(path.substr(1));
+  while (std::getline(stream, name, '/')) id += "/" + util::Url::escape(name);
+  return id;
+}
+
 IHttpRequest::Pointer OwnCloud::getItemDataRequest(const std::string& id,
                                                    std::ostream&) const {
   auto request =
@@ -147,31 +205,34 @@ IHttpRequest::Pointer OwnCloud::renameItemRequest(const IItem& item,
 }
 
 IItem::Pointer OwnCloud::getItemDataResponse(std::istream& stream) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str(), sstream.str().size()) !=
-      tinyxml2::XML_SUCCESS)
+  IItem::Pointer item;
+  MultistatusParser parser([&](const std::string& href, size_t size) {
+    if (!item) item = toItem(href, size);
+  });
+  parser.write(stream);
+  std::string next_page_token;
+  if (!parser.finish(next_page_token) || !item)
     throw std::logic_error("failed to parse xml");
-  return toItem(document.RootElement()->FirstChild());
+  return item;
 }
 
 std::vector<IItem::Pointer> OwnCloud::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string&) const {
-  std::stringstream sstream;
-  sstream << stream.rdbuf();
-  tinyxml2::XMLDocument document;
-  if (document.Parse(sstream.str().c_str(), sstream.str().size()) !=
-      tinyxml2::XML_SUCCESS)
-    throw std::logic_error("failed to parse xml");
-  if (document.RootElement()->FirstChild() == nullptr) return {};
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
 
-  std::vector<IItem::Pointer> result;
-  for (auto child = document.RootElement()->FirstChild()->NextSibling(); child;
-       child = child->NextSibling()) {
-    result.push_back(toItem(child));
-  }
-  return result;
+CloudProvider::ListDirectoryParser::Pointer OwnCloud::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  // first response describes the directory itself
+  auto first = std::make_shared<bool>(true);
+  return std::make_shared<MultistatusParser>(
+      [=](const std::string& href, size_t size) {
+        if (*first)
+          *first = false;
+        else
+          received(toItem(href, size));
+      });
 }
 
 std::string OwnCloud::api_url() const {
@@ -179,27 +240,15 @@ std::string OwnCloud::api_url() const {
   return "https://" + user_ + ":" + password_ + "@" + owncloud_base_url_;
 }
 
-IItem::Pointer OwnCloud::toItem(const tinyxml2::XMLNode* node) const {
-  if (!node) throw std::logic_error("invalid xml");
-  auto element = node->FirstChildElement("d:href");
-  if (!element) throw std::logic_error("invalid xml");
-  std::string id = element->GetText();
-  id = id.substr(strlen("/remote.php/webdav"));
+IItem::Pointer OwnCloud::toItem(const std::string& href, size_t size) const {
+  std::string id = href.substr(strlen("/remote.php/webdav"));
   IItem::FileType type = IItem::FileType::Unknown;
   if (id.back() == '/') type = IItem::FileType::Directory;
   std::string filename = id;
   if (filename.back() == '/') filename.pop_back();
   filename = filename.substr(filename.find_last_of('/') + 1);
-  auto get_size = [](const tinyxml2::XMLNode* node) {
-    auto propstat = node->FirstChildElement("d:propstat");
-    if (!propstat) return IItem::UnknownSize;
-    auto prop = propstat->FirstChildElement("d:prop");
-    if (!prop) return IItem::UnknownSize;
-    auto size = prop->FirstChildElement("d:getcontentlength");
-    return size ? (size_t)std::atoll(size->GetText()) : IItem::UnknownSize;
-  };
-  auto item = util::make_unique<Item>(util::Url::unescape(filename), id,
-                                      get_size(node), type);
+  auto item =
+      util::make_unique<Item>(util::Url::unescape(filename), id, size, type);
   item->set_url(api_url() + "/remote.php/webdav" + id);
   return std::move(item);
 }
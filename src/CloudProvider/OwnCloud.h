@@ -24,8 +24,6 @@
 #ifndef OWNCLOUD_H
 #define OWNCLOUD_H
 
-#include <tinyxml2.h>
-
 #include "CloudProvider.h"
 
 namespace cloudstorage {
@@ -54,6 +52,7 @@ class OwnCloud : public CloudProvider {
   CreateDirectoryRequest::Pointer createDirectoryAsync(
       IItem::Pointer, const std::string&, CreateDirectoryCallback) override;
 
+  std::string pathToId(const std::string& path) const override;
   IHttpRequest::Pointer getItemDataRequest(
       const std::string&, std::ostream& input_stream) const override;
   IHttpRequest::Pointer listDirectoryRequest(
@@ -75,10 +74,12 @@ class OwnCloud : public CloudProvider {
   IItem::Pointer getItemDataResponse(std::istream& response) const override;
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
 
   std::string api_url() const;
 
-  IItem::Pointer toItem(const tinyxml2::XMLNode*) const;
+  IItem::Pointer toItem(const std::string& href, size_t size) const;
 
   bool reauthorize(int code) const override;
   void authorizeRequest(IHttpRequest&) const override;
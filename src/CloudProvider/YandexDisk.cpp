@@ -48,6 +48,10 @@ IItem::Pointer YandexDisk::rootDirectory() const {
                                  IItem::FileType::Directory);
 }
 
+std::string YandexDisk::pathToId(const std::string& path) const {
+  return "disk:" + path;
+}
+
 ICloudProvider::GetItemDataRequest::Pointer YandexDisk::getItemDataAsync(
     const std::string& id, GetItemDataCallback callback) {
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
@@ -63,7 +67,7 @@ ICloudProvider::GetItemDataRequest::Pointer YandexDisk::getItemDataAsync(
         [=](EitherError<util::Output> e) {
           if (e.left()) {
             callback(e.left());
-            r->done(e.left());
+            return r->done(e.left());
           }
           try {
             Json::Value json;
@@ -110,6 +114,8 @@ ICloudProvider::GetItemDataRequest::Pointer YandexDisk::getItemDataAsync(
   return r->run();
 }
 
+bool YandexDisk::segmentedDownload() const { return false; }
+
 ICloudProvider::DownloadFileRequest::Pointer YandexDisk::downloadFileAsync(
     IItem::Pointer item, IDownloadFileCallback::Pointer callback, Range range) {
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
@@ -229,6 +235,7 @@ ICloudProvider::UploadFileRequest::Pointer YandexDisk::uploadFileAsync(
 ICloudProvider::CreateDirectoryRequest::Pointer
 YandexDisk::createDirectoryAsync(IItem::Pointer parent, const std::string& name,
                                  CreateDirectoryCallback callback) {
+  callback = invalidatePaths(nullptr, parent, callback);
   auto r = std::make_shared<Request<EitherError<IItem>>>(shared_from_this());
   r->set([=](Request<EitherError<IItem>>::Pointer r) {
     auto output = std::make_shared<std::stringstream>();
@@ -321,21 +328,26 @@ IHttpRequest::Pointer YandexDisk::renameItemRequest(const IItem& item,
 }
 
 std::vector<IItem::Pointer> YandexDisk::listDirectoryResponse(
-    const IItem&, std::istream& stream, std::string& next_page_token) const {
-  Json::Value response;
-  stream >> response;
-  std::vector<IItem::Pointer> result;
-  for (const Json::Value& v : response["_embedded"]["items"])
-    result.push_back(toItem(v));
-  int offset = response["_embedded"]["offset"].asInt();
-  int limit = response["_embedded"]["limit"].asInt();
-  int total_count = response["_embedded"]["total"].asInt();
-  if (offset + limit < total_count)
-    next_page_token = std::to_string(offset + limit);
-  return result;
+    const IItem& directory, std::istream& stream,
+    std::string& next_page_token) const {
+  return parseListDirectory(directory, stream, next_page_token);
+}
+
+CloudProvider::ListDirectoryParser::Pointer YandexDisk::listDirectoryParser(
+    const IItem&, ListDirectoryParser::ItemReceived received) const {
+  return jsonListParser(
+      "_embedded/items", [=](const util::JsonView& v) { return toItem(v); },
+      received,
+      [](const Json::Value& response, std::string& next_page_token) {
+        int offset = response["_embedded"]["offset"].asInt();
+        int limit = response["_embedded"]["limit"].asInt();
+        int total_count = response["_embedded"]["total"].asInt();
+        if (offset + limit < total_count)
+          next_page_token = std::to_string(offset + limit);
+      });
 }
 
-IItem::Pointer YandexDisk::toItem(const Json::Value& v) const {
+IItem::Pointer YandexDisk::toItem(const util::JsonView& v) const {
   IItem::FileType type = v["type"].asString() == "dir"
                              ? IItem::FileType::Directory
                              : Item::fromMimeType(v["mime_type"].asString());
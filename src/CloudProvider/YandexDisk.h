@@ -38,11 +38,13 @@ class YandexDisk : public CloudProvider {
   std::string endpoint() const override;
   IItem::Pointer rootDirectory() const override;
 
+  std::string pathToId(const std::string& path) const override;
   GetItemDataRequest::Pointer getItemDataAsync(
       const std::string& id, GetItemDataCallback callback) override;
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer,
                                                  IDownloadFileCallback::Pointer,
                                                  Range) override;
+  bool segmentedDownload() const override;
   UploadFileRequest::Pointer uploadFileAsync(
       IItem::Pointer, const std::string&,
       IUploadFileCallback::Pointer) override;
@@ -61,8 +63,10 @@ class YandexDisk : public CloudProvider {
 
   std::vector<IItem::Pointer> listDirectoryResponse(
       const IItem&, std::istream&, std::string& next_page_token) const override;
+  ListDirectoryParser::Pointer listDirectoryParser(
+      const IItem&, ListDirectoryParser::ItemReceived) const override;
 
-  IItem::Pointer toItem(const Json::Value&) const;
+  IItem::Pointer toItem(const util::JsonView&) const;
   void authorizeRequest(IHttpRequest&) const override;
 
   class Auth : public cloudstorage::Auth {
@@ -139,7 +139,7 @@ ICloudProvider::GetItemDataRequest::Pointer YouTube::getItemDataAsync(
                 auto input = std::make_shared<std::stringstream>();
                 auto output = std::make_shared<std::stringstream>();
                 auto error = std::make_shared<std::stringstream>();
-                r->send(request.get(),
+                r->send(request,
                         [=](IHttpRequest::Response response) {
                           if (IHttpRequest::isSuccess(response.http_code_))
                             static_cast<Item*>(item.get())
@@ -168,6 +168,8 @@ ICloudProvider::GetItemDataRequest::Pointer YouTube::getItemDataAsync(
   return r->run();
 }
 
+bool YouTube::segmentedDownload() const { return false; }
+
 ICloudProvider::DownloadFileRequest::Pointer YouTube::downloadFileAsync(
     IItem::Pointer item, IDownloadFileCallback::Pointer callback, Range range) {
   auto r = std::make_shared<Request<EitherError<void>>>(shared_from_this());
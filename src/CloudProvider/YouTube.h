@@ -48,6 +48,7 @@ class YouTube : public CloudProvider {
   DownloadFileRequest::Pointer downloadFileAsync(IItem::Pointer,
                                                  IDownloadFileCallback::Pointer,
                                                  Range) override;
+  bool segmentedDownload() const override;
 
  private:
   IHttpRequest::Pointer getItemDataRequest(const std::string&,
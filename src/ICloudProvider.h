@@ -54,6 +54,7 @@ class ICloudProvider {
   using CreateDirectoryRequest = IRequest<EitherError<IItem>>;
   using MoveItemRequest = IRequest<EitherError<void>>;
   using RenameItemRequest = IRequest<EitherError<void>>;
+  using WalkTreeRequest = IRequest<EitherError<void>>;
 
   class IAuthCallback {
    public:
@@ -129,6 +130,74 @@ class ICloudProvider {
     *  - success_page (page to be displayed when library was authorized
     *    successfully)
     *  - error_page (page to be displayed when library authorization failed)
+    *  - http_engine (used when http_engine_ isn't provided, either "event"
+    *    (default) or "poll")
+    *  - http_workers (used when http_engine_ isn't provided, number of
+    *    threads running transfers; 0 means one per core, defaults to 1)
+    *  - http_balance (used when http_engine_ isn't provided, either "load"
+    *    (default) to pick the least loaded worker or "host" to keep requests
+    *    to one host on the same worker)
+    *  - http_share (used when http_engine_ isn't provided, either "process"
+    *    (default) to share dns cache and tls sessions with other providers or
+    *    "instance" to keep them private)
+    *  - http2 (used when http_engine_ isn't provided, "false" disables
+    *    http/2 multiplexing which is used by default when server supports it)
+    *  - http_max_host_connections (used when http_engine_ isn't provided,
+    *    limit of connections per host, unlimited by default)
+    *  - http_max_streams (used when http_engine_ isn't provided, limit of
+    *    concurrent http/2 streams per connection, 100 by default)
+    *  - http_max_requests (used when http_engine_ isn't provided, limit of
+    *    requests running at once per worker, above it requests wait and are
+    *    started interactive first, bulk last; unlimited by default)
+    *  - http_max_bulk_requests (used when http_engine_ isn't provided, limit
+    *    of bulk transfers running at once per worker, 8 by default; each
+    *    segment of a download counts as one, so it also bounds
+    *    download_segments)
+    *  - retry_max_attempts (how many times a request failing with transient
+    *    error is sent at most, 5 by default)
+    *  - retry_base_delay, retry_max_delay (in milliseconds, bounds of
+    *    exponential backoff between retries, 500 and 60000 by default)
+    *  - concurrency_initial, concurrency_max (initial and maximal value of
+    *    the adaptive limit of concurrent http requests, 8 and 64 by default;
+    *    0 as maximum disables the limit)
+    *  - concurrency_max_queue (how many requests may wait for the limit
+    *    before new ones get rejected with 429, unlimited by default)
+    *  - download_segments (count of concurrent range requests a file of
+    *    known size is downloaded with, 1 by default; segments are bulk
+    *    transfers, so with the default http engine no more than
+    *    http_max_bulk_requests of them run at once)
+    *  - download_segment_size (size in bytes of each range, 8 MiB by
+    *    default; smaller files are downloaded with one request)
+    *  - download_checkpoint ("true" makes downloads to file record finished
+    *    segments in filename.checkpoint and resume from it, provided the
+    *    file's size and ETag didn't change; disabled by default)
+    *  - path_cache_ttl (in milliseconds, how long directory listings done by
+    *    getItemAsync are reused by its next calls, 10000 by default; 0
+    *    disables the cache)
+    *  - path_cache_size (limit of directory listings kept by getItemAsync,
+    *    1024 by default)
+    *  - metadata_cache ("true" makes ICloudStorage::provider wrap the
+    *    provider in a cache of directory listings and items' metadata, used
+    *    by listDirectoryAsync and getItemDataAsync; disabled by default)
+    *  - metadata_cache_ttl (in milliseconds, how long cached entries are
+    *    fresh, 60000 by default; 0 disables the cache)
+    *  - metadata_cache_stale (in milliseconds, how long after ttl entries are
+    *    still returned while they're fetched again, 300000 by default)
+    *  - metadata_cache_entries, metadata_cache_bytes (limits of cached
+    *    entries and their estimated size, 4096 and 64 MiB by default)
+    *  - metadata_cache_snapshot (path of a file directory listings cached
+    *    by metadata_cache are saved to; in the next session listings found
+    *    there are returned as stale and fetched again in background; one
+    *    file per provider, unset by default)
+    *  - s3_part_size (used by amazon s3, files bigger than that are uploaded
+    *    with multipart upload in parts of this size, 16 MiB by default and at
+    *    least 5 MiB; raised when the file would have more than 10000 parts)
+    *  - s3_upload_parallelism (used by amazon s3, count of parts uploaded at
+    *    once, 4 by default)
+    *  - s3_endpoint (used by amazon s3, base url of an S3 compatible server,
+    *    e.g. http://127.0.0.1:9000; region's AWS endpoint by default)
+    *  - s3_path_style ("true" addresses buckets as endpoint/bucket/key instead
+    *    of bucket.endpoint/key; defaults to "true" when s3_endpoint is set)
     */
     Hints hints_;
   };
@@ -357,6 +426,25 @@ class ICloudProvider {
       IItem::Pointer directory, const std::string& token = "",
       ListDirectoryPageCallback = [](EitherError<PageData>) {}) = 0;
 
+  /**
+   * Walks the tree rooted at directory, keeping up to parallel directory
+   * listings in flight at once; items are passed to the callback while
+   * listings are downloaded. Walk stops at the first listing which failed.
+   *
+   * @param directory root of the tree, it isn't passed to the callback
+   *
+   * @param parallel maximal count of directories listed at once
+   *
+   * @param max_depth directories at this depth aren't listed, 0 means there is
+   * no limit
+   *
+   * @return object representing the pending request
+   */
+  virtual WalkTreeRequest::Pointer walkTreeAsync(IItem::Pointer directory,
+                                                 IWalkTreeCallback::Pointer,
+                                                 uint32_t parallel = 4,
+                                                 uint32_t max_depth = 0) = 0;
+
   /**
    * Simplified version of listDirectoryAsync.
    *
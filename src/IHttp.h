@@ -33,18 +33,45 @@ namespace cloudstorage {
 
 class IHttpRequest {
  public:
+  using Pointer = std::shared_ptr<IHttpRequest>;
+  using GetParameters = std::unordered_map<std::string, std::string>;
+  using HeaderParameters = std::unordered_map<std::string, std::string>;
+
+  /**
+   * Durations in seconds measured from the start of the request until given
+   * phase was completed; zero if it wasn't measured.
+   */
+  struct Timing {
+    double name_lookup_;
+    double connect_;
+    double tls_handshake_;
+    double start_transfer_;
+    double total_;
+  };
+
   struct Response {
     int http_code_;
     uint64_t content_length_;
     std::shared_ptr<std::ostream> output_stream_;
     std::shared_ptr<std::ostream> error_stream_;
+
+    /**
+     * Headers of the final response, names are lower case; repeated headers
+     * are joined with ", ".
+     */
+    HeaderParameters headers_;
+    Timing timing_;
   };
 
-  using Pointer = std::shared_ptr<IHttpRequest>;
-  using GetParameters = std::unordered_map<std::string, std::string>;
-  using HeaderParameters = std::unordered_map<std::string, std::string>;
   using CompleteCallback = std::function<void(Response)>;
 
+  /**
+   * Interactive requests are started before the others; bulk ones are large
+   * transfers, only a limited number of them runs at once so that they don't
+   * delay the rest.
+   */
+  enum class Priority { Interactive, Normal, Bulk };
+
   static constexpr int Ok = 200;
   static constexpr int Partial = 206;
   static constexpr int Bad = 400;
@@ -52,7 +79,11 @@ class IHttpRequest {
   static constexpr int Forbidden = 403;
   static constexpr int NotFound = 404;
   static constexpr int RangeInvalid = 416;
+  static constexpr int TooManyRequests = 429;
+  static constexpr int InternalServerError = 500;
+  static constexpr int BadGateway = 502;
   static constexpr int ServiceUnavailable = 503;
+  static constexpr int GatewayTimeout = 504;
   static constexpr int Aborted = 600;
   static constexpr int Unknown = 700;
   static constexpr int Failure = 800;
@@ -132,6 +163,19 @@ class IHttpRequest {
    */
   virtual bool follow_redirect() const = 0;
 
+  /**
+   * Sets class of the request, Normal by default; engines which don't
+   * schedule requests may ignore it.
+   *
+   * @param priority
+   */
+  virtual void setPriority(Priority) {}
+
+  /**
+   * @return class of the request
+   */
+  virtual Priority priority() const { return Priority::Normal; }
+
   /**
    * Sends http request in an asynchronous fashion.
    *
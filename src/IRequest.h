@@ -115,6 +115,40 @@ class IListDirectoryCallback {
   virtual void done(EitherError<std::vector<IItem::Pointer>>) = 0;
 };
 
+class IWalkTreeCallback {
+ public:
+  using Pointer = std::shared_ptr<IWalkTreeCallback>;
+
+  virtual ~IWalkTreeCallback() = default;
+
+  /**
+   * Called with every item of the walked tree, in no particular order; calls
+   * are never concurrent.
+   *
+   * @param item found item
+   * @param path path of the item relative to the walked directory, e.g. /a/b
+   * @param depth depth of the item, walked directory's children have depth 1
+   * @return whether directory's children should be walked as well, ignored
+   * for files
+   */
+  virtual bool receivedItem(IItem::Pointer item, const std::string& path,
+                            uint32_t depth) = 0;
+
+  /**
+   * Called after each directory was listed.
+   *
+   * @param listed count of directories listed so far
+   * @param found count of directories found so far, including listed ones
+   * @param items count of items passed to receivedItem so far
+   */
+  virtual void progress(uint64_t listed, uint64_t found, uint64_t items) = 0;
+
+  /**
+   * Called when the whole tree was walked or when the walk failed.
+   */
+  virtual void done(EitherError<void>) = 0;
+};
+
 class IDownloadFileCallback {
  public:
   using Pointer = std::shared_ptr<IDownloadFileCallback>;
@@ -116,7 +116,7 @@ void AuthorizeRequest::oauth2Authorization(AuthorizeCompleted complete) {
   auto r = provider()->auth()->refreshTokenRequest(*input);
   auto auth = provider()->auth();
   auto auth_callback = provider()->auth_callback();
-  send(r.get(),
+  send(r,
        [=](IHttpRequest::Response response) {
          if (IHttpRequest::isSuccess(response.http_code_)) {
            try {
@@ -141,7 +141,7 @@ void AuthorizeRequest::oauth2Authorization(AuthorizeCompleted complete) {
                   output = std::make_shared<std::stringstream>(),
                   error_stream = std::make_shared<std::stringstream>();
              auto r = auth->exchangeAuthorizationCodeRequest(*input);
-             send(r.get(),
+             send(r,
                   [=](IHttpRequest::Response response) {
                     if (IHttpRequest::isSuccess(response.http_code_)) {
                       try {
@@ -49,7 +49,7 @@ ExchangeCodeRequest::ExchangeCodeRequest(std::shared_ptr<CloudProvider> p,
       request = provider()->auth()->exchangeAuthorizationCodeRequest(*input);
       provider()->auth()->set_authorization_code(previous_code);
     }
-    r->send(request.get(),
+    r->send(request,
             [=](IHttpRequest::Response response) {
               if (IHttpRequest::isSuccess(response.http_code_)) {
                 try {
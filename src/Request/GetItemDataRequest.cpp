@@ -31,6 +31,7 @@ namespace cloudstorage {
 GetItemDataRequest::GetItemDataRequest(std::shared_ptr<CloudProvider> p,
                                        const std::string& id, Callback callback)
     : Request(p) {
+  set_priority(IHttpRequest::Priority::Interactive);
   set([=](Request::Pointer request) {
     auto response_stream = std::make_shared<std::stringstream>();
     sendRequest(
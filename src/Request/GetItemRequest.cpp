@@ -30,13 +30,14 @@ namespace cloudstorage {
 GetItemRequest::GetItemRequest(std::shared_ptr<CloudProvider> p,
                                const std::string& path, Callback callback)
     : Request(p) {
+  set_priority(IHttpRequest::Priority::Interactive);
   set([=](Request::Pointer) {
     if (path.empty() || path.front() != '/') {
       Error e{IHttpRequest::Forbidden, "invalid path"};
       callback(e);
       return done(e);
     }
-    work(provider()->rootDirectory(), path, callback);
+    work(provider()->rootDirectory(), "", path, callback);
   });
 }
 
@@ -49,8 +50,8 @@ IItem::Pointer GetItemRequest::getItem(const std::vector<IItem::Pointer>& items,
   return nullptr;
 }
 
-void GetItemRequest::work(IItem::Pointer item, std::string p,
-                          Callback complete) {
+void GetItemRequest::work(IItem::Pointer item, std::string prefix,
+                          std::string p, Callback complete) {
   if (!item) {
     Error e{IHttpRequest::NotFound, "not found"};
     complete(e);
@@ -68,6 +69,12 @@ void GetItemRequest::work(IItem::Pointer item, std::string p,
               rest = it == std::string::npos
                          ? ""
                          : std::string(path.begin() + it, path.end());
+  auto cache = provider()->path_cache();
+  IItem::Pointer child;
+  // name missing from cached listing may have been created since, so it's
+  // listed again
+  if (cache->lookup(prefix, *item, name, child) && child)
+    return work(child, prefix + "/" + name, rest, complete);
   auto request = this->shared_from_this();
   subrequest(provider()->listDirectoryAsync(
       item, [=](EitherError<std::vector<IItem::Pointer>> e) {
@@ -75,7 +82,9 @@ void GetItemRequest::work(IItem::Pointer item, std::string p,
           complete(e.left());
           request->done(e.left());
         } else {
-          work(getItem(*e.right(), name), rest, complete);
+          cache->add(prefix, *item, *e.right());
+          work(getItem(*e.right(), name), prefix + "/" + name, rest,
+               complete);
         }
       }));
 }
@@ -39,7 +39,17 @@ class GetItemRequest : public Request<EitherError<IItem>> {
  private:
   IItem::Pointer getItem(const std::vector<IItem::Pointer>& items,
                          const std::string& name) const;
-  void work(IItem::Pointer item, std::string path, Callback);
+
+  /**
+   * Resolves rest of the path starting at item; listings are looked up in
+   * provider's path cache first.
+   *
+   * @param item resolved directory
+   * @param prefix path of item, empty for root
+   * @param path path left to resolve, relative to item
+   */
+  void work(IItem::Pointer item, std::string prefix, std::string path,
+            Callback);
 };
 
 }  // namespace cloudstorage
@@ -32,6 +32,7 @@ ListDirectoryPageRequest::ListDirectoryPageRequest(
     const std::string& token, ListDirectoryPageCallback completed,
     std::function<bool(int)> fault_tolerant)
     : Request(p) {
+  set_priority(IHttpRequest::Priority::Interactive);
   set([=](Request<EitherError<PageData>>::Pointer r) {
     if (directory->type() != IItem::FileType::Directory) {
       Error e{IHttpRequest::Bad, "file not a directory"};
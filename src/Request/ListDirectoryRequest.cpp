@@ -27,10 +27,67 @@
 
 namespace cloudstorage {
 
+namespace {
+
+class ParserBuffer : public std::streambuf {
+ public:
+  ParserBuffer(CloudProvider::ListDirectoryParser::Pointer parser)
+      : parser_(parser), written_() {}
+
+  CloudProvider::ListDirectoryParser::Pointer parser() const {
+    return parser_;
+  }
+
+  void set_parser(CloudProvider::ListDirectoryParser::Pointer parser) {
+    parser_ = parser;
+    written_ = false;
+  }
+
+  bool written() const { return written_; }
+
+ protected:
+  std::streamsize xsputn(const char* data, std::streamsize length) override {
+    written_ = true;
+    parser_->write(data, static_cast<size_t>(length));
+    return length;
+  }
+
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      char data = traits_type::to_char_type(c);
+      xsputn(&data, 1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+ private:
+  CloudProvider::ListDirectoryParser::Pointer parser_;
+  bool written_;
+};
+
+/**
+ * Passes everything written to it to the parser.
+ */
+class ParserStream : public std::ostream {
+ public:
+  ParserStream(CloudProvider::ListDirectoryParser::Pointer parser)
+      : std::ostream(nullptr), buffer_(parser) {
+    rdbuf(&buffer_);
+  }
+
+  ParserBuffer& buffer() { return buffer_; }
+
+ private:
+  ParserBuffer buffer_;
+};
+
+}  // namespace
+
 ListDirectoryRequest::ListDirectoryRequest(
     std::shared_ptr<CloudProvider> p, IItem::Pointer directory,
     ICallback::Pointer callback, std::function<bool(int)> fault_tolerant)
     : Request(p) {
+  set_priority(IHttpRequest::Priority::Interactive);
   set([=](Request::Pointer request) {
     if (directory->type() != IItem::FileType::Directory) {
       Error e{IHttpRequest::Forbidden, "trying to list non directory"};
@@ -48,6 +105,10 @@ void ListDirectoryRequest::work(IItem::Pointer directory,
                                 std::string page_token,
                                 ICallback::Pointer callback,
                                 std::function<bool(int)> fault_tolerant) {
+  auto reported = std::make_shared<size_t>(0);
+  if (auto parser = this->parser(directory, callback, reported))
+    return workStreaming(directory, page_token, callback, fault_tolerant,
+                         parser, reported);
   auto output_stream = std::make_shared<std::stringstream>();
   auto request = this->shared_from_this();
   sendRequest(
@@ -82,4 +143,51 @@ void ListDirectoryRequest::work(IItem::Pointer directory,
       output_stream);
 }
 
+void ListDirectoryRequest::workStreaming(
+    IItem::Pointer directory, std::string page_token,
+    ICallback::Pointer callback, std::function<bool(int)> fault_tolerant,
+    CloudProvider::ListDirectoryParser::Pointer parser,
+    std::shared_ptr<size_t> reported) {
+  auto request = this->shared_from_this();
+  auto stream = std::make_shared<ParserStream>(parser);
+  sendRequest(
+      [=](util::Output i) {
+        // response of the previous attempt was cut off
+        if (stream->buffer().written())
+          stream->buffer().set_parser(
+              this->parser(directory, callback, reported));
+        return provider()->listDirectoryRequest(*directory, page_token, *i);
+      },
+      [=](EitherError<util::Output> e) {
+        if (e.left() && !fault_tolerant(e.left()->code_)) {
+          callback->done(e.left());
+          return request->done(e.left());
+        }
+        std::string next_page_token;
+        if (e.right() && !stream->buffer().parser()->finish(next_page_token)) {
+          Error err{IHttpRequest::Failure, "invalid directory listing"};
+          callback->done(err);
+          return request->done(err);
+        }
+        if (!next_page_token.empty())
+          return work(directory, next_page_token, callback, fault_tolerant);
+        callback->done(result_);
+        request->done(result_);
+      },
+      stream);
+}
+
+CloudProvider::ListDirectoryParser::Pointer ListDirectoryRequest::parser(
+    IItem::Pointer directory, ICallback::Pointer callback,
+    std::shared_ptr<size_t> reported) {
+  auto seen = std::make_shared<size_t>(0);
+  return provider()->listDirectoryParser(
+      *directory, [=](IItem::Pointer item) {
+        if (++*seen <= *reported) return;
+        ++*reported;
+        callback->receivedItem(item);
+        result_.push_back(item);
+      });
+}
+
 }  // namespace cloudstorage
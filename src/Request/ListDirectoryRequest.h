@@ -24,6 +24,7 @@
 #ifndef LISTDIRECTORYREQUEST_H
 #define LISTDIRECTORYREQUEST_H
 
+#include "CloudProvider/CloudProvider.h"
 #include "IItem.h"
 #include "Request.h"
 
@@ -45,6 +46,25 @@ class ListDirectoryRequest
   void work(IItem::Pointer directory, std::string page_token,
             ICallback::Pointer, std::function<bool(int)> fault_tolerant);
 
+  /**
+   * Lists the page with provider's listDirectoryParser, reporting items while
+   * the response is being downloaded.
+   */
+  void workStreaming(IItem::Pointer directory, std::string page_token,
+                     ICallback::Pointer,
+                     std::function<bool(int)> fault_tolerant,
+                     CloudProvider::ListDirectoryParser::Pointer,
+                     std::shared_ptr<size_t> reported);
+
+  /**
+   * Creates parser which reports page's items to the callback; items counted
+   * in reported were already reported by parser of an earlier attempt to
+   * download the page and are skipped.
+   */
+  CloudProvider::ListDirectoryParser::Pointer parser(
+      IItem::Pointer directory, ICallback::Pointer,
+      std::shared_ptr<size_t> reported);
+
   std::vector<IItem::Pointer> result_;
 };
 
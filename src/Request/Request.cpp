@@ -55,17 +55,24 @@ T Request<T>::Wrapper::result() {
   return request_->result();
 }
 
+template <class T>
+void Request<T>::Wrapper::abort() {
+  request_->abort();
+}
+
 template <class T>
 Request<T>::Request(std::shared_ptr<CloudProvider> provider)
     : future_(value_.get_future()),
       provider_shared_(provider),
-      is_cancelled_(false) {}
+      is_cancelled_(false),
+      priority_(IHttpRequest::Priority::Normal) {}
 
 template <class T>
 Request<T>::Request(std::weak_ptr<CloudProvider> provider)
     : future_(value_.get_future()),
       provider_weak_(provider),
-      is_cancelled_(false) {}
+      is_cancelled_(false),
+      priority_(IHttpRequest::Priority::Normal) {}
 
 template <class T>
 Request<T>::~Request() {
@@ -95,8 +102,24 @@ void Request<T>::finish() {
 template <class T>
 void Request<T>::cancel() {
   if (is_cancelled()) return;
-  is_cancelled_ = true;
+  abort();
   auto p = provider();
+  if (p) {
+    std::unique_lock<std::mutex> lock(p->current_authorization_mutex_);
+    if (p->auth_callbacks_.empty() && p->current_authorization_) {
+      auto auth = std::move(p->current_authorization_);
+      lock.unlock();
+      auth->cancel();
+    }
+  }
+  finish();
+}
+
+template <class T>
+void Request<T>::abort() {
+  if (is_cancelled_.exchange(true)) return;
+  auto p = provider();
+  AuthorizeRequest::Pointer auth;
   if (p) {
     std::unique_lock<std::mutex> lock(p->current_authorization_mutex_);
     auto it = p->auth_callbacks_.find(this);
@@ -112,22 +135,19 @@ void Request<T>::cancel() {
       }
       p->auth_callbacks_.erase(it);
     }
-    if (p->auth_callbacks_.empty() && p->current_authorization_) {
-      auto auth = std::move(p->current_authorization_);
-      lock.unlock();
-      auth->cancel();
-    }
+    auth = p->current_authorization_;
   }
   {
     std::unique_lock<std::mutex> lock(subrequest_mutex_);
     for (size_t i = 0; i < subrequests_.size(); i++) {
       auto r = subrequests_[i];
       lock.unlock();
-      r->cancel();
+      // authorization in progress is shared with other requests and
+      // cancelling it waits for it to finish
+      if (r != auth) r->cancel();
       lock.lock();
     }
   }
-  finish();
 }
 
 template <class T>
@@ -199,17 +219,43 @@ void Request<T>::sendRequest(RequestFactory factory, RequestCompleted complete,
                              std::shared_ptr<std::ostream> output,
                              ProgressFunction download,
                              ProgressFunction upload) {
+  sendRequest(factory,
+              [=](EitherError<IHttpRequest::Response> e) {
+                if (e.left())
+                  complete(e.left());
+                else
+                  complete(output);
+              },
+              output, download, upload, 0, false);
+}
+
+template <class T>
+void Request<T>::sendRequestWithResponse(RequestFactory factory,
+                                         ResponseCompleted complete,
+                                         std::shared_ptr<std::ostream> output,
+                                         ProgressFunction download,
+                                         ProgressFunction upload) {
+  sendRequest(factory, complete, output, download, upload, 0, false);
+}
+
+template <class T>
+void Request<T>::sendRequest(RequestFactory factory, ResponseCompleted complete,
+                             std::shared_ptr<std::ostream> output,
+                             ProgressFunction download, ProgressFunction upload,
+                             uint32_t attempt, bool reauthorized) {
   auto request = this->shared_from_this();
   auto input = std::make_shared<std::stringstream>(),
        error_stream = std::make_shared<std::stringstream>();
   auto r = factory(input);
   authorize(r);
-  send(r.get(),
+  std::string method = r ? r->method() : "";
+  send(r,
        [=](IHttpRequest::Response response) {
          if (IHttpRequest::isSuccess(response.http_code_))
-           return complete(output);
-         if (this->reauthorize(response.http_code_)) {
-           this->reauthorize([=](EitherError<void> e) {
+           return complete(response);
+         if (!reauthorized && this->reauthorize(response.http_code_)) {
+           return this->reauthorize([=](EitherError<void> e) {
+             (void)request;
              if (e.left()) {
                if (e.left()->code_ != IHttpRequest::Aborted)
                  return complete(e.left());
@@ -217,40 +263,70 @@ void Request<T>::sendRequest(RequestFactory factory, RequestCompleted complete,
                  return complete(
                      Error{response.http_code_, error_stream->str()});
              }
-             auto input = std::make_shared<std::stringstream>(),
-                  error_stream = std::make_shared<std::stringstream>();
-             auto r = factory(input);
-             authorize(r);
-             this->send(
-                 r.get(),
-                 [=](IHttpRequest::Response response) {
-                   (void)request;
-                   if (IHttpRequest::isSuccess(response.http_code_))
-                     complete(output);
-                   else
-                     complete(Error{response.http_code_, error_stream->str()});
-                 },
-                 input, output, error_stream, download, upload);
+             this->sendRequest(factory, complete, output, download, upload,
+                               attempt, true);
            });
-         } else {
-           complete(Error{response.http_code_, error_stream->str()});
          }
+         auto p = provider();
+         auto delay = p ? p->retryDelay(response, method, attempt)
+                        : std::chrono::milliseconds(-1);
+         if (delay.count() < 0 || is_cancelled())
+           return complete(Error{response.http_code_, error_stream->str()});
+         subrequest(p->timer()->schedule(delay, [=]() {
+           if (request->is_cancelled())
+             complete(Error{IHttpRequest::Aborted, ""});
+           else
+             request->sendRequest(factory, complete, output, download, upload,
+                                  attempt + 1, reauthorized);
+         }));
        },
        input, output, error_stream, download, upload);
 }
 
 template <class T>
-void Request<T>::send(IHttpRequest* request,
+void Request<T>::send(IHttpRequest::Pointer request,
                       IHttpRequest::CompleteCallback complete,
                       std::shared_ptr<std::istream> input,
                       std::shared_ptr<std::ostream> output,
                       std::shared_ptr<std::ostream> error,
                       ProgressFunction download, ProgressFunction upload) {
-  if (request)
-    request->send(complete, input, output, error,
-                  httpCallback(download, upload));
-  else
-    complete({IHttpRequest::Aborted, 0, output, error});
+  if (!request)
+    return complete({IHttpRequest::Aborted, 0, output, error, {}, {}});
+  request->setPriority(priority_);
+  auto p = provider();
+  if (!p)
+    return request->send(complete, input, output, error,
+                         httpCallback(download, upload));
+  auto admission = p->admission();
+  auto priority = priority_.load();
+  subrequest(admission->admit(priority, [=](bool admitted) {
+    if (!admitted)
+      return complete({is_cancelled() ? IHttpRequest::Aborted
+                                      : IHttpRequest::TooManyRequests,
+                       0, output, error, {}, {}});
+    auto start = std::chrono::steady_clock::now();
+    request->send(
+        [=](IHttpRequest::Response response) {
+          auto latency = response.timing_.start_transfer_;
+          if (latency <= 0)
+            latency = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+          admission->release(priority, response.http_code_, latency);
+          complete(response);
+        },
+        input, output, error, httpCallback(download, upload));
+  }));
+}
+
+template <class T>
+void Request<T>::set_priority(IHttpRequest::Priority priority) {
+  priority_ = priority;
+}
+
+template <class T>
+IHttpRequest::Priority Request<T>::priority() const {
+  return priority_;
 }
 
 template <class T>
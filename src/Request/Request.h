@@ -50,6 +50,8 @@ class Request : public IRequest<ReturnValue>,
   using Resolver = std::function<void(std::shared_ptr<Request>)>;
   using AuthorizeCompleted = std::function<void(EitherError<void>)>;
   using RequestCompleted = std::function<void(EitherError<util::Output>)>;
+  using ResponseCompleted =
+      std::function<void(EitherError<IHttpRequest::Response>)>;
 
   class Wrapper : public IRequest<ReturnValue> {
    public:
@@ -60,6 +62,12 @@ class Request : public IRequest<ReturnValue>,
     void cancel() override;
     ReturnValue result() override;
 
+    /**
+     * Aborts wrapped request; wrapper of aborted request doesn't wait for it
+     * when destroyed, so it can be released even by request's own callback.
+     */
+    void abort();
+
    private:
     Request::Pointer request_;
   };
@@ -72,6 +80,13 @@ class Request : public IRequest<ReturnValue>,
   void cancel() override;
   ReturnValue result() override;
 
+  /**
+   * Works like cancel, but doesn't wait for the request to finish: aborts
+   * running http requests and cancels pending retries, admissions and
+   * subrequests. Used by requests which fail before all their work is done.
+   */
+  void abort();
+
   void set(Resolver);
   typename Wrapper::Pointer run();
   void done(const ReturnValue&);
@@ -87,7 +102,9 @@ class Request : public IRequest<ReturnValue>,
 
   /**
    * Sends a request created by factory function; if request failed, tries to do
-   * authorization and does the request again.
+   * authorization and does the request again. Requests which failed with
+   * transient errors are sent again after a delay given by
+   * CloudProvider::retryDelay.
    *
    * @param factory function which should create request to perform
    * @param output output stream
@@ -101,7 +118,19 @@ class Request : public IRequest<ReturnValue>,
                    ProgressFunction download = nullptr,
                    ProgressFunction upload = nullptr);
 
-  void send(IHttpRequest*, IHttpRequest::CompleteCallback complete,
+  /**
+   * Works like sendRequest, but passes the whole response of the successful
+   * request, e.g. to look at its headers.
+   */
+  void sendRequestWithResponse(RequestFactory factory, ResponseCompleted,
+                               std::shared_ptr<std::ostream> output,
+                               ProgressFunction download = nullptr,
+                               ProgressFunction upload = nullptr);
+
+  /**
+   * Sends the request once cloud provider's admission controller lets it.
+   */
+  void send(IHttpRequest::Pointer, IHttpRequest::CompleteCallback complete,
             std::shared_ptr<std::istream> input,
             std::shared_ptr<std::ostream> output,
             std::shared_ptr<std::ostream> error,
@@ -110,6 +139,12 @@ class Request : public IRequest<ReturnValue>,
 
   std::shared_ptr<CloudProvider> provider() const;
 
+  /**
+   * Sets priority of http requests sent by this request.
+   */
+  void set_priority(IHttpRequest::Priority);
+  IHttpRequest::Priority priority() const;
+
   bool is_cancelled();
 
   void subrequest(std::shared_ptr<IGenericRequest>);
@@ -120,6 +155,11 @@ class Request : public IRequest<ReturnValue>,
  private:
   friend class AuthorizeRequest;
 
+  void sendRequest(RequestFactory factory, ResponseCompleted,
+                   std::shared_ptr<std::ostream> output,
+                   ProgressFunction download, ProgressFunction upload,
+                   uint32_t attempt, bool reauthorized);
+
   std::unique_ptr<HttpCallback> httpCallback(
       ProgressFunction progress_download = nullptr,
       ProgressFunction progress_upload = nullptr);
@@ -131,6 +171,7 @@ class Request : public IRequest<ReturnValue>,
   std::shared_ptr<CloudProvider> provider_shared_;
   std::weak_ptr<CloudProvider> provider_weak_;
   std::atomic_bool is_cancelled_;
+  std::atomic<IHttpRequest::Priority> priority_;
   std::mutex subrequest_mutex_;
   std::vector<std::shared_ptr<IGenericRequest>> subrequests_;
 };
@@ -0,0 +1,466 @@
+/*****************************************************************************
+ * SegmentedDownloadRequest.cpp : SegmentedDownloadRequest implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "SegmentedDownloadRequest.h"
+
+#include "CloudProvider/CloudProvider.h"
+#include "Utility/Utility.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const std::string CHECKPOINT_HEADER = "cloudstorage-checkpoint 1";
+
+}  // namespace
+
+namespace cloudstorage {
+
+SegmentBuffer::SegmentBuffer(uint64_t size)
+    : fd_(-1), offset_(), size_(size), received_(), failed_() {
+  data_.reserve(size);
+}
+
+SegmentBuffer::SegmentBuffer(int fd, uint64_t offset, uint64_t size)
+    : fd_(fd), offset_(offset), size_(size), received_(), failed_() {}
+
+std::streamsize SegmentBuffer::xsputn(const char_type* data,
+                                      std::streamsize length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (failed_ || received_ + length > size_) {
+    failed_ = true;
+    return length;
+  }
+  if (fd_ == -1) {
+    data_.append(data, length);
+  } else {
+#ifndef _WIN32
+    std::streamsize written = 0;
+    while (written < length) {
+      auto count =
+          pwrite(fd_, data + written, length - written,
+                 static_cast<off_t>(offset_ + received_ + written));
+      if (count <= 0) {
+        failed_ = true;
+        return length;
+      }
+      written += count;
+    }
+#else
+    failed_ = true;
+#endif
+  }
+  received_ += length;
+  return length;
+}
+
+bool SegmentBuffer::complete() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !failed_ && received_ == size_;
+}
+
+const std::string& SegmentBuffer::data() const { return data_; }
+
+void SegmentBuffer::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  failed_ = true;
+}
+
+DownloadCheckpoint::DownloadCheckpoint(const std::string& path)
+    : path_(path), fd_(-1) {}
+
+DownloadCheckpoint::~DownloadCheckpoint() {
+#ifndef _WIN32
+  if (fd_ != -1) close(fd_);
+#endif
+}
+
+bool DownloadCheckpoint::load(uint64_t size, uint64_t segment_size) {
+  std::ifstream file(path_);
+  std::string line;
+  std::stringstream header;
+  header << CHECKPOINT_HEADER << " " << size << " " << segment_size;
+  if (!std::getline(file, line) || line != header.str()) return false;
+  etag_.clear();
+  segments_.clear();
+  // last line may be incomplete if the process was killed while writing it
+  while (std::getline(file, line) && !file.eof()) {
+    if (line.compare(0, strlen("etag "), "etag ") == 0)
+      etag_ = line.substr(strlen("etag "));
+    else if (line.compare(0, strlen("segment "), "segment ") == 0)
+      segments_.insert(std::atoll(line.c_str() + strlen("segment ")));
+  }
+#ifndef _WIN32
+  fd_ = open(path_.c_str(), O_WRONLY | O_APPEND);
+#endif
+  return fd_ != -1;
+}
+
+bool DownloadCheckpoint::reset(uint64_t size, uint64_t segment_size) {
+  etag_.clear();
+  segments_.clear();
+#ifndef _WIN32
+  if (fd_ != -1) close(fd_);
+  fd_ = open(path_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC, 0644);
+#endif
+  std::stringstream header;
+  header << CHECKPOINT_HEADER << " " << size << " " << segment_size;
+  append(header.str());
+  return fd_ != -1;
+}
+
+void DownloadCheckpoint::set_etag(const std::string& etag) {
+  etag_ = etag;
+  append("etag " + etag);
+}
+
+void DownloadCheckpoint::add_segment(uint64_t index) {
+  segments_.insert(index);
+  append("segment " + std::to_string(index));
+}
+
+void DownloadCheckpoint::remove() {
+#ifndef _WIN32
+  if (fd_ != -1) close(fd_);
+  fd_ = -1;
+#endif
+  std::remove(path_.c_str());
+}
+
+const std::string& DownloadCheckpoint::etag() const { return etag_; }
+
+const std::set<uint64_t>& DownloadCheckpoint::segments() const {
+  return segments_;
+}
+
+void DownloadCheckpoint::append(const std::string& line) {
+#ifndef _WIN32
+  if (fd_ == -1) return;
+  std::string data = line + "\n";
+  ssize_t ret = write(fd_, data.c_str(), data.length());
+  (void)ret;
+#endif
+}
+
+SegmentedDownloadRequest::SegmentedDownloadRequest(
+    std::shared_ptr<CloudProvider> p, IItem::Pointer file,
+    ICallback::Pointer callback, Range range, RequestFactory request_factory,
+    Parameters parameters)
+    : Request(p),
+      file_(file),
+      callback_(callback),
+      range_(range),
+      request_factory_(request_factory),
+      parameters_(parameters),
+      fd_(-1),
+      delivered_(),
+      running_(),
+      received_(),
+      validated_(true),
+      reported_(),
+      delivering_() {
+  set_priority(IHttpRequest::Priority::Bulk);
+  if (range_.size_ == Range::Full) range_.size_ = file->size() - range_.start_;
+  segment_count_ = (range_.size_ + parameters_.segment_size_ - 1) /
+                   parameters_.segment_size_;
+  for (uint64_t i = 0; i < segment_count_; i++) waiting_.push_back(i);
+  set([=](Request::Pointer) { start(); });
+}
+
+SegmentedDownloadRequest::SegmentedDownloadRequest(
+    std::shared_ptr<CloudProvider> p, IItem::Pointer file,
+    const std::string& path, DownloadFileCallback callback,
+    RequestFactory request_factory, Parameters parameters)
+    : Request(p),
+      file_(file),
+      file_callback_(callback),
+      range_({Range::Begin, file->size()}),
+      request_factory_(request_factory),
+      parameters_(parameters),
+      fd_(-1),
+      delivered_(),
+      running_(),
+      received_(),
+      validated_(true),
+      reported_(),
+      delivering_() {
+  set_priority(IHttpRequest::Priority::Bulk);
+  segment_count_ = (range_.size_ + parameters_.segment_size_ - 1) /
+                   parameters_.segment_size_;
+  set([=](Request::Pointer) {
+    openFile(path);
+    if (fd_ == -1)
+      fail(Error{IHttpRequest::Failure, "couldn't open file " + path});
+    else
+      start();
+  });
+}
+
+SegmentedDownloadRequest::~SegmentedDownloadRequest() {
+  cancel();
+#ifndef _WIN32
+  if (fd_ != -1) close(fd_);
+#endif
+}
+
+void SegmentedDownloadRequest::openFile(const std::string& path) {
+#ifndef _WIN32
+  if (!parameters_.checkpoint_) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    for (uint64_t i = 0; i < segment_count_; i++) waiting_.push_back(i);
+    return;
+  }
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd_ == -1) return;
+  checkpoint_ = util::make_unique<DownloadCheckpoint>(path + ".checkpoint");
+  bool resumed = checkpoint_->load(range_.size_, parameters_.segment_size_);
+  struct stat st;
+  if (resumed && fstat(fd_, &st) == 0) {
+    for (auto index : checkpoint_->segments()) {
+      uint64_t end = std::min((index + 1) * parameters_.segment_size_,
+                              range_.size_);
+      if (index >= segment_count_ || end > static_cast<uint64_t>(st.st_size))
+        resumed = false;
+    }
+  } else {
+    resumed = false;
+  }
+  if (!resumed) {
+    if (ftruncate(fd_, 0) != 0 ||
+        !checkpoint_->reset(range_.size_, parameters_.segment_size_)) {
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+  }
+  etag_ = checkpoint_->etag();
+  validated_ = etag_.empty();
+  for (uint64_t i = 0; i < segment_count_; i++)
+    if (checkpoint_->segments().find(i) == checkpoint_->segments().end())
+      waiting_.push_back(i);
+    else
+      delivered_++;
+#else
+  (void)path;
+#endif
+}
+
+void SegmentedDownloadRequest::start() {
+  auto request = this->shared_from_this();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (reported_) return;
+  if (delivered_ == segment_count_) {
+    reported_ = true;
+    lock.unlock();
+    return succeeded();
+  }
+  uint32_t parallel = validated_ ? parameters_.segments_ : 1;
+  uint64_t max_waiting = 2 * static_cast<uint64_t>(parameters_.segments_);
+  while (running_ < parallel && !waiting_.empty() &&
+         (!callback_ || waiting_.front() < delivered_ + max_waiting)) {
+    uint64_t index = waiting_.front();
+    waiting_.pop_front();
+    uint64_t offset = index * parameters_.segment_size_;
+    Range range{range_.start_ + offset,
+                std::min(parameters_.segment_size_, range_.size_ - offset)};
+    auto buffer = callback_ ? std::make_shared<SegmentBuffer>(range.size_)
+                            : std::make_shared<SegmentBuffer>(
+                                  fd_, offset, range.size_);
+    auto stream = std::make_shared<std::ostream>(buffer.get());
+    running_++;
+    transfers_.insert(buffer);
+    lock.unlock();
+    sendRequestWithResponse(
+        [=](util::Output input) {
+          auto r = request_factory_(*file_, *input);
+          if (r) r->setHeaderParameter("Range", util::range_to_string(range));
+          return r;
+        },
+        [=](EitherError<IHttpRequest::Response> e) {
+          (void)request;
+          (void)stream;
+          finished(index, buffer, e);
+        },
+        stream);
+    lock.lock();
+    if (reported_) return;
+  }
+}
+
+void SegmentedDownloadRequest::finished(uint64_t index,
+                                        SegmentBuffer::Pointer buffer,
+                                        EitherError<IHttpRequest::Response> e) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  running_--;
+  transfers_.erase(buffer);
+  if (reported_) return;
+  if (e.left()) {
+    auto p = provider();
+    // transfer broken in the middle isn't retried by sendRequest, as part of
+    // the response was already written; segment can be just fetched again
+    if (e.left()->code_ < 0 && p &&
+        ++attempts_[index] < p->retry_policy().max_attempts_) {
+      waiting_.push_front(index);
+      lock.unlock();
+      return start();
+    }
+    lock.unlock();
+    return fail(*e.left());
+  }
+  const auto& headers = e.right()->headers_;
+  auto content_range = headers.find("content-range");
+  if (content_range != headers.end() && file_->size() != IItem::UnknownSize) {
+    auto total = content_range->second.substr(
+        content_range->second.find_last_of('/') + 1);
+    if (total != "*" &&
+        static_cast<uint64_t>(std::atoll(total.c_str())) != file_->size()) {
+      lock.unlock();
+      return fail(Error{IHttpRequest::Failure, "file size changed"});
+    }
+  }
+  auto etag_header = headers.find("etag");
+  auto etag = etag_header != headers.end() ? etag_header->second : "";
+  if (!validated_) {
+    validated_ = true;
+    if (!etag.empty() && etag != etag_) {
+      // file changed since the checkpoint was written, start over
+      waiting_.clear();
+      for (uint64_t i = 0; i < segment_count_; i++) waiting_.push_back(i);
+      delivered_ = 0;
+      attempts_.clear();
+      etag_.clear();
+#ifndef _WIN32
+      if (ftruncate(fd_, 0) != 0 ||
+          !checkpoint_->reset(range_.size_, parameters_.segment_size_)) {
+        lock.unlock();
+        return fail(Error{IHttpRequest::Failure, "couldn't reset file"});
+      }
+#endif
+      // the segment was truncated away, it's fetched again with the others
+      lock.unlock();
+      return start();
+    }
+  }
+  if (etag_.empty() && !etag.empty()) {
+    etag_ = etag;
+    if (checkpoint_) checkpoint_->set_etag(etag_);
+  } else if (!etag.empty() && etag != etag_) {
+    lock.unlock();
+    return fail(Error{IHttpRequest::Failure, "file changed during download"});
+  }
+  if (!buffer->complete()) {
+    lock.unlock();
+    return fail(Error{IHttpRequest::Failure, "range request not honored"});
+  }
+  if (!callback_) {
+    if (checkpoint_) {
+      lock.unlock();
+#ifndef _WIN32
+      fdatasync(fd_);
+#endif
+      lock.lock();
+      if (reported_) return;
+      checkpoint_->add_segment(index);
+    }
+    delivered_++;
+    lock.unlock();
+    return start();
+  }
+  buffered_[index] = buffer;
+  if (delivering_) return;
+  delivering_ = true;
+  while (!reported_) {
+    auto it = buffered_.find(delivered_);
+    if (it == buffered_.end()) break;
+    auto segment = it->second;
+    buffered_.erase(it);
+    delivered_++;
+    received_ += segment->data().size();
+    auto received = received_;
+    lock.unlock();
+    callback_->receivedData(segment->data().data(),
+                            static_cast<uint32_t>(segment->data().size()));
+    callback_->progress(static_cast<uint32_t>(range_.size_),
+                        static_cast<uint32_t>(received));
+    lock.lock();
+  }
+  delivering_ = false;
+  lock.unlock();
+  start();
+}
+
+void SegmentedDownloadRequest::succeeded() {
+  std::set<SegmentBuffer::Pointer> transfers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    transfers = std::move(transfers_);
+    transfers_.clear();
+  }
+  // nothing may be written to fd_ once it's closed
+  for (const auto& buffer : transfers) buffer->stop();
+#ifndef _WIN32
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+#endif
+  if (checkpoint_) checkpoint_->remove();
+  if (callback_)
+    callback_->done(nullptr);
+  else
+    file_callback_(nullptr);
+  done(nullptr);
+}
+
+void SegmentedDownloadRequest::fail(Error e) {
+  std::set<SegmentBuffer::Pointer> transfers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reported_) return;
+    reported_ = true;
+    waiting_.clear();
+    transfers = std::move(transfers_);
+    transfers_.clear();
+  }
+  for (const auto& buffer : transfers) buffer->stop();
+  // running segments finish with an error and free their admission slots,
+  // retries waiting on the timer are dropped
+  abort();
+  if (callback_)
+    callback_->done(e);
+  else
+    file_callback_(e);
+  done(e);
+}
+
+}  // namespace cloudstorage
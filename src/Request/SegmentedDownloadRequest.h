@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * SegmentedDownloadRequest.h : SegmentedDownloadRequest headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef SEGMENTEDDOWNLOADREQUEST_H
+#define SEGMENTEDDOWNLOADREQUEST_H
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "DownloadFileRequest.h"
+
+namespace cloudstorage {
+
+/**
+ * Collects one segment of the file; doesn't accept more data than the
+ * segment's size, so that server which ignored Range header can't make it
+ * buffer the whole file.
+ */
+class SegmentBuffer : public std::streambuf {
+ public:
+  using Pointer = std::shared_ptr<SegmentBuffer>;
+
+  /**
+   * Keeps the data in memory.
+   */
+  SegmentBuffer(uint64_t size);
+
+  /**
+   * Writes the data to file descriptor at given offset.
+   */
+  SegmentBuffer(int fd, uint64_t offset, uint64_t size);
+
+  std::streamsize xsputn(const char_type* data,
+                         std::streamsize length) override;
+
+  /**
+   * @return whether exactly size bytes were received and stored
+   */
+  bool complete() const;
+  const std::string& data() const;
+
+  /**
+   * Makes the buffer drop all further data; once it returns, nothing more is
+   * written to the file.
+   */
+  void stop();
+
+ private:
+  mutable std::mutex mutex_;
+  int fd_;
+  uint64_t offset_;
+  uint64_t size_;
+  uint64_t received_;
+  bool failed_;
+  std::string data_;
+};
+
+/**
+ * Append-only log stored next to the file being downloaded. Its first line
+ * identifies the download by file's size and segment size, next ones record
+ * file's ETag and indices of segments which were completely written.
+ */
+class DownloadCheckpoint {
+ public:
+  using Pointer = std::unique_ptr<DownloadCheckpoint>;
+
+  DownloadCheckpoint(const std::string& path);
+  ~DownloadCheckpoint();
+
+  /**
+   * Reads the checkpoint and opens it for appending.
+   *
+   * @return false if there is no checkpoint or it describes another download
+   */
+  bool load(uint64_t size, uint64_t segment_size);
+
+  /**
+   * Starts a new checkpoint, discarding the previous one.
+   */
+  bool reset(uint64_t size, uint64_t segment_size);
+
+  void set_etag(const std::string&);
+  void add_segment(uint64_t index);
+
+  /**
+   * Removes the checkpoint once the download is complete.
+   */
+  void remove();
+
+  const std::string& etag() const;
+  const std::set<uint64_t>& segments() const;
+
+ private:
+  void append(const std::string& line);
+
+  std::string path_;
+  int fd_;
+  std::string etag_;
+  std::set<uint64_t> segments_;
+};
+
+/**
+ * Downloads the file with several concurrent Range requests. Segments are
+ * passed to the callback in order; those which arrived before their
+ * predecessors wait in memory and no segment is started when it would make
+ * more than twice the count of parallel segments wait. When downloading to
+ * file, segments are written at their offsets as they arrive and finished
+ * ones may be recorded in DownloadCheckpoint, so that the next download of
+ * the same file fetches only the missing ones.
+ */
+class SegmentedDownloadRequest : public Request<EitherError<void>> {
+ public:
+  using RequestFactory = DownloadFileRequest::RequestFactory;
+  using ICallback = IDownloadFileCallback;
+
+  struct Parameters {
+    uint32_t segments_;
+    uint64_t segment_size_;
+
+    /**
+     * Whether download to file keeps its progress in path + ".checkpoint";
+     * checkpoint is validated with file's size and ETag, if server sends
+     * one.
+     */
+    bool checkpoint_;
+  };
+
+  SegmentedDownloadRequest(std::shared_ptr<CloudProvider>, IItem::Pointer file,
+                           ICallback::Pointer, Range,
+                           RequestFactory request_factory, Parameters);
+  SegmentedDownloadRequest(std::shared_ptr<CloudProvider>, IItem::Pointer file,
+                           const std::string& path, DownloadFileCallback,
+                           RequestFactory request_factory, Parameters);
+  ~SegmentedDownloadRequest();
+
+ private:
+  void openFile(const std::string& path);
+  void start();
+  void finished(uint64_t index, SegmentBuffer::Pointer,
+                EitherError<IHttpRequest::Response>);
+  void succeeded();
+  void fail(Error);
+
+  IItem::Pointer file_;
+  ICallback::Pointer callback_;
+  DownloadFileCallback file_callback_;
+  Range range_;
+  RequestFactory request_factory_;
+  Parameters parameters_;
+  int fd_;
+  DownloadCheckpoint::Pointer checkpoint_;
+  std::mutex mutex_;
+  uint64_t segment_count_;
+
+  /**
+   * Indices of segments which weren't started yet, in ascending order
+   * except for failed segments which are tried again first.
+   */
+  std::deque<uint64_t> waiting_;
+
+  /**
+   * Count of segments passed to the callback or written to file.
+   */
+  uint64_t delivered_;
+  uint32_t running_;
+
+  /**
+   * Buffers of running segments, stopped when the download fails.
+   */
+  std::set<SegmentBuffer::Pointer> transfers_;
+  uint64_t received_;
+  std::map<uint64_t, uint32_t> attempts_;
+
+  /**
+   * ETag of the file; until first segment of resumed download arrives, it's
+   * the one read from checkpoint and only one segment runs at a time.
+   */
+  std::string etag_;
+  bool validated_;
+
+  /**
+   * Whether the result was already passed to the callback.
+   */
+  bool reported_;
+
+  /**
+   * Whether some thread is passing segments to the callback.
+   */
+  bool delivering_;
+  std::map<uint64_t, SegmentBuffer::Pointer> buffered_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // SEGMENTEDDOWNLOADREQUEST_H
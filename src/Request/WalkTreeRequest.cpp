@@ -0,0 +1,211 @@
+/*****************************************************************************
+ * WalkTreeRequest.cpp : WalkTreeRequest implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "WalkTreeRequest.h"
+
+#include "CloudProvider/CloudProvider.h"
+
+#include <algorithm>
+
+namespace cloudstorage {
+
+namespace {
+
+using ListDirectoryWrapper =
+    Request<EitherError<std::vector<IItem::Pointer>>>::Wrapper;
+
+/**
+ * Aborts the listing without waiting for it; listings of all the providers
+ * are wrappers of Request.
+ */
+void abortListing(const std::shared_ptr<IGenericRequest>& listing) {
+  auto wrapper = dynamic_cast<ListDirectoryWrapper*>(listing.get());
+  if (wrapper) wrapper->abort();
+}
+
+}  // namespace
+
+class WalkTreeRequest::ListCallback : public IListDirectoryCallback {
+ public:
+  ListCallback(std::shared_ptr<WalkTreeRequest> request, uint64_t id,
+               Directory directory)
+      : request_(request), id_(id), directory_(std::move(directory)) {}
+
+  void receivedItem(IItem::Pointer item) override {
+    auto request = request_.lock();
+    if (request) request->received(directory_, item);
+  }
+
+  void done(EitherError<std::vector<IItem::Pointer>> e) override {
+    auto request = request_.lock();
+    if (request) request->listed(id_, e);
+  }
+
+ private:
+  std::weak_ptr<WalkTreeRequest> request_;
+  uint64_t id_;
+  Directory directory_;
+};
+
+WalkTreeRequest::WalkTreeRequest(std::shared_ptr<CloudProvider> p,
+                                 IItem::Pointer directory,
+                                 ICallback::Pointer callback,
+                                 uint32_t parallel, uint32_t max_depth)
+    : Request(p),
+      callback_(callback),
+      parallel_(std::max<uint32_t>(parallel, 1)),
+      max_depth_(max_depth),
+      next_id_(),
+      listed_(),
+      found_(1),
+      items_(),
+      reported_() {
+  waiting_.push_back({directory, "", 0});
+  set([=](Request::Pointer) { start(); });
+}
+
+WalkTreeRequest::~WalkTreeRequest() { cancel(); }
+
+void WalkTreeRequest::cancel() {
+  if (is_cancelled()) return;
+  std::vector<std::shared_ptr<IGenericRequest>> running;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& listing : running_)
+      if (listing.second) running.push_back(listing.second);
+  }
+  report(Error{IHttpRequest::Aborted, ""});
+  for (const auto& listing : running) listing->finish();
+  Request::cancel();
+}
+
+void WalkTreeRequest::start() {
+  auto p = provider();
+  if (!p) return report(Error{IHttpRequest::Aborted, ""});
+  auto request =
+      std::static_pointer_cast<WalkTreeRequest>(this->shared_from_this());
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!reported_ && running_.size() < parallel_ && !waiting_.empty()) {
+    auto directory = waiting_.back();
+    waiting_.pop_back();
+    auto id = next_id_++;
+    running_[id] = nullptr;
+    lock.unlock();
+    IListDirectoryCallback::Pointer callback =
+        std::make_shared<ListCallback>(request, id, directory);
+    std::shared_ptr<IGenericRequest> listing =
+        p->listDirectoryAsync(directory.item_, callback);
+    lock.lock();
+    auto it = running_.find(id);
+    if (it != running_.end()) it->second = listing;
+    if (it == running_.end() || reported_) {
+      // listing finished already or the walk failed in the meantime
+      lock.unlock();
+      abortListing(listing);
+      lock.lock();
+    }
+  }
+  if (!reported_ && running_.empty() && waiting_.empty()) {
+    lock.unlock();
+    report(nullptr);
+  }
+}
+
+void WalkTreeRequest::received(const Directory& parent, IItem::Pointer item) {
+  Directory directory{item, parent.path_ + "/" + item->filename(),
+                      parent.depth_ + 1};
+  bool walk;
+  {
+    std::lock_guard<std::mutex> callback_lock(callback_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (reported_) return;
+      items_++;
+    }
+    walk = callback_->receivedItem(item, directory.path_, directory.depth_);
+  }
+  if (!walk || item->type() != IItem::FileType::Directory ||
+      (max_depth_ != 0 && directory.depth_ >= max_depth_))
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reported_) return;
+    found_++;
+    waiting_.push_back(std::move(directory));
+  }
+  start();
+}
+
+void WalkTreeRequest::listed(uint64_t id,
+                             EitherError<std::vector<IItem::Pointer>> e) {
+  std::shared_ptr<IGenericRequest> listing;
+  bool reported;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = running_.find(id);
+    if (it != running_.end()) {
+      listing = std::move(it->second);
+      running_.erase(it);
+    }
+    reported = reported_;
+    if (!reported) listed_++;
+  }
+  // the listing only waits for this callback to return, so it's aborted to
+  // let its wrapper go here
+  if (listing) {
+    abortListing(listing);
+    listing = nullptr;
+  }
+  if (reported) return;
+  if (e.left()) return report(e.left());
+  {
+    std::lock_guard<std::mutex> callback_lock(callback_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (reported_) return;
+    auto listed = listed_, found = found_, items = items_;
+    lock.unlock();
+    callback_->progress(listed, found, items);
+  }
+  start();
+}
+
+void WalkTreeRequest::report(EitherError<void> e) {
+  std::vector<std::shared_ptr<IGenericRequest>> running;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reported_) return;
+    reported_ = true;
+    waiting_.clear();
+    if (e.left())
+      for (const auto& listing : running_)
+        if (listing.second) running.push_back(listing.second);
+  }
+  for (const auto& listing : running) abortListing(listing);
+  {
+    std::lock_guard<std::mutex> callback_lock(callback_mutex_);
+    callback_->done(e);
+  }
+  done(e);
+}
+
+}  // namespace cloudstorage
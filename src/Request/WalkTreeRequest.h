@@ -0,0 +1,94 @@
+/*****************************************************************************
+ * WalkTreeRequest.h : WalkTreeRequest headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef WALKTREEREQUEST_H
+#define WALKTREEREQUEST_H
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Request.h"
+
+namespace cloudstorage {
+
+/**
+ * Lists directories of the tree with provider's listDirectoryAsync, up to
+ * given count at once. Directories waiting to be listed are taken newest
+ * first, so that the walk goes deep before it goes wide and the count of
+ * waiting directories stays small.
+ */
+class WalkTreeRequest : public Request<EitherError<void>> {
+ public:
+  using ICallback = IWalkTreeCallback;
+
+  WalkTreeRequest(std::shared_ptr<CloudProvider>, IItem::Pointer directory,
+                  ICallback::Pointer, uint32_t parallel, uint32_t max_depth);
+  ~WalkTreeRequest();
+
+  void cancel() override;
+
+ private:
+  class ListCallback;
+
+  struct Directory {
+    IItem::Pointer item_;
+    std::string path_;
+    uint32_t depth_;
+  };
+
+  void start();
+  void received(const Directory& parent, IItem::Pointer item);
+
+  void listed(uint64_t id, EitherError<std::vector<IItem::Pointer>>);
+
+  /**
+   * Reports the result once; failed walk aborts listings still running.
+   */
+  void report(EitherError<void>);
+
+  ICallback::Pointer callback_;
+  uint32_t parallel_;
+  uint32_t max_depth_;
+  std::mutex mutex_;
+  std::vector<Directory> waiting_;
+
+  /**
+   * Listings in flight; entry is null while the listing is being started.
+   */
+  std::unordered_map<uint64_t, std::shared_ptr<IGenericRequest>> running_;
+  uint64_t next_id_;
+  uint64_t listed_;
+  uint64_t found_;
+  uint64_t items_;
+  bool reported_;
+
+  /**
+   * Serializes calls to the callback.
+   */
+  std::mutex callback_mutex_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // WALKTREEREQUEST_H
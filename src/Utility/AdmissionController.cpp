@@ -0,0 +1,247 @@
+/*****************************************************************************
+ * AdmissionController.cpp : AdmissionController implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "AdmissionController.h"
+
+#include "IHttp.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace cloudstorage {
+
+namespace {
+
+const uint32_t INITIAL_WINDOW = 8;
+const uint32_t MAX_WINDOW = 64;
+const double THROTTLE_DECREASE = 0.5;
+const double LATENCY_DECREASE = 0.8;
+const double LATENCY_FACTOR = 2;
+const double FAST_LATENCY_WEIGHT = 0.2;
+const double SLOW_LATENCY_WEIGHT = 0.02;
+const uint32_t MIN_DECREASE_INTERVAL = 100;
+
+// part of the window bulk requests may take, the rest is left to short ones
+const double BULK_SHARE = 0.75;
+
+}  // namespace
+
+AdmissionController::Ticket::Ticket(
+    Callback callback, IHttpRequest::Priority priority,
+    std::weak_ptr<AdmissionController> controller)
+    : callback_(std::move(callback)),
+      priority_(priority),
+      controller_(controller),
+      done_() {}
+
+void AdmissionController::Ticket::finish() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return done_; });
+}
+
+void AdmissionController::Ticket::cancel() {
+  if (auto controller = controller_.lock()) controller->remove(this);
+  run(false);
+}
+
+bool AdmissionController::Ticket::run(bool admitted) {
+  Callback callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!callback_) return false;
+    callback = std::move(callback_);
+    callback_ = nullptr;
+  }
+  callback(admitted);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  finished_.notify_all();
+  return true;
+}
+
+IHttpRequest::Priority AdmissionController::Ticket::priority() const {
+  return priority_;
+}
+
+AdmissionController::Config::Config()
+    : initial_window_(INITIAL_WINDOW),
+      min_window_(1),
+      max_window_(MAX_WINDOW),
+      max_queue_(0) {}
+
+AdmissionController::Config AdmissionController::Config::fromHints(
+    const std::unordered_map<std::string, std::string>& hints) {
+  Config config;
+  auto it = hints.find("concurrency_initial");
+  if (it != hints.end() && std::atoi(it->second.c_str()) > 0)
+    config.initial_window_ =
+        static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("concurrency_max");
+  if (it != hints.end())
+    config.max_window_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("concurrency_max_queue");
+  if (it != hints.end())
+    config.max_queue_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  return config;
+}
+
+AdmissionController::AdmissionController(Config config)
+    : config_(config),
+      window_(config.max_window_ == 0
+                  ? 0
+                  : std::min(std::max(config.initial_window_,
+                                      config.min_window_),
+                             config.max_window_)),
+      in_flight_(),
+      bulk_in_flight_(),
+      fast_latency_(),
+      slow_latency_(),
+      admitted_(),
+      rejected_(),
+      throttled_(),
+      decreased_() {}
+
+AdmissionController::Ticket::Pointer AdmissionController::admit(
+    IHttpRequest::Priority priority, Callback callback) {
+  auto ticket = std::make_shared<Ticket>(std::move(callback), priority,
+                                         shared_from_this());
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (config_.max_window_ == 0 || (queue(priority).empty() && fits(priority))) {
+    in_flight_++;
+    if (priority == IHttpRequest::Priority::Bulk) bulk_in_flight_++;
+    admitted_++;
+    lock.unlock();
+    ticket->run(true);
+  } else if (config_.max_queue_ != 0 && queued() >= config_.max_queue_) {
+    rejected_++;
+    lock.unlock();
+    ticket->run(false);
+  } else {
+    queue(priority).push_back(ticket);
+  }
+  return ticket;
+}
+
+void AdmissionController::release(IHttpRequest::Priority priority, int code,
+                                  double latency) {
+  auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  in_flight_--;
+  if (priority == IHttpRequest::Priority::Bulk) bulk_in_flight_--;
+  if (config_.max_window_ == 0) return;
+  if (code == IHttpRequest::TooManyRequests ||
+      code == IHttpRequest::ServiceUnavailable) {
+    throttled_++;
+    decrease(THROTTLE_DECREASE, now);
+  } else if (code >= IHttpRequest::Ok && code < 500) {
+    if (latency > 0) {
+      if (slow_latency_ == 0) {
+        fast_latency_ = slow_latency_ = latency;
+      } else {
+        fast_latency_ += FAST_LATENCY_WEIGHT * (latency - fast_latency_);
+        slow_latency_ += SLOW_LATENCY_WEIGHT * (latency - slow_latency_);
+      }
+    }
+    if (fast_latency_ > LATENCY_FACTOR * slow_latency_)
+      decrease(LATENCY_DECREASE, now);
+    else
+      window_ = std::min<double>(window_ + 1 / window_, config_.max_window_);
+  }
+  while (true) {
+    std::vector<Ticket::Pointer> tickets;
+    for (auto& q : queues_)
+      while (!q.empty() && fits(q.front()->priority())) {
+        if (q.front()->priority() == IHttpRequest::Priority::Bulk)
+          bulk_in_flight_++;
+        tickets.push_back(q.front());
+        q.pop_front();
+        in_flight_++;
+      }
+    if (tickets.empty()) return;
+    lock.unlock();
+    std::vector<Ticket::Pointer> cancelled;
+    for (auto&& t : tickets)
+      if (!t->run(true)) cancelled.push_back(t);
+    lock.lock();
+    admitted_ += tickets.size() - cancelled.size();
+    if (cancelled.empty()) return;
+    for (auto&& t : cancelled) {
+      in_flight_--;
+      if (t->priority() == IHttpRequest::Priority::Bulk) bulk_in_flight_--;
+    }
+  }
+}
+
+AdmissionController::Statistics AdmissionController::statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {window_,    in_flight_, queued(),
+          admitted_,  rejected_,  throttled_,
+          decreased_, fast_latency_};
+}
+
+void AdmissionController::remove(const Ticket* ticket) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& q = queue(ticket->priority());
+  auto it = std::find_if(
+      q.begin(), q.end(),
+      [ticket](const Ticket::Pointer& t) { return t.get() == ticket; });
+  if (it != q.end()) q.erase(it);
+}
+
+bool AdmissionController::fits(IHttpRequest::Priority priority) const {
+  if (in_flight_ >= static_cast<uint32_t>(window_)) return false;
+  // requests of higher classes are admitted first
+  for (size_t i = 0; i < static_cast<size_t>(priority); i++)
+    if (!queues_[i].empty()) return false;
+  return priority != IHttpRequest::Priority::Bulk ||
+         bulk_in_flight_ <
+             std::max<uint32_t>(1, static_cast<uint32_t>(window_ * BULK_SHARE));
+}
+
+AdmissionController::Queue& AdmissionController::queue(
+    IHttpRequest::Priority priority) {
+  return queues_[static_cast<size_t>(priority)];
+}
+
+uint32_t AdmissionController::queued() const {
+  size_t count = 0;
+  for (const auto& q : queues_) count += q.size();
+  return static_cast<uint32_t>(count);
+}
+
+void AdmissionController::decrease(double factor,
+                                   std::chrono::steady_clock::time_point now) {
+  if (now < next_decrease_) return;
+  window_ = std::max<double>(window_ * factor, config_.min_window_);
+  decreased_++;
+  // responses to requests sent before the cut arrive within a round trip,
+  // they shouldn't cut the window again
+  next_decrease_ =
+      now + std::max(std::chrono::milliseconds(MIN_DECREASE_INTERVAL),
+                     std::chrono::milliseconds(
+                         static_cast<int64_t>(fast_latency_ * 1000)));
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,189 @@
+/*****************************************************************************
+ * AdmissionController.h : AdmissionController headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef ADMISSIONCONTROLLER_H
+#define ADMISSIONCONTROLLER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "IHttp.h"
+#include "IRequest.h"
+
+namespace cloudstorage {
+
+/**
+ * Limits how many http requests of a cloud provider are in flight. The window
+ * grows by one request per round trip while responses are fast and
+ * successful; it's cut by half when server throttles (429, 503) and by a
+ * smaller factor when latency rises well above its long term average.
+ * Requests which don't fit in the window wait in fifo queue of their priority
+ * class; interactive ones are admitted first, then normal and bulk ones. Bulk
+ * requests hold their slot for the whole transfer, so they may take only a
+ * part of the window.
+ */
+class AdmissionController
+    : public std::enable_shared_from_this<AdmissionController> {
+ public:
+  using Pointer = std::shared_ptr<AdmissionController>;
+
+  /**
+   * Called when the request may be sent or, with false, when it was rejected
+   * because the queue was full or the ticket was cancelled.
+   */
+  using Callback = std::function<void(bool admitted)>;
+
+  class Ticket : public IGenericRequest {
+   public:
+    using Pointer = std::shared_ptr<Ticket>;
+
+    Ticket(Callback, IHttpRequest::Priority,
+           std::weak_ptr<AdmissionController>);
+
+    void finish() override;
+
+    /**
+     * Removes the ticket from controller's queue and runs the callback with
+     * false, unless it was already run.
+     */
+    void cancel() override;
+
+    /**
+     * Runs the callback unless it was already run.
+     *
+     * @return whether the callback was run
+     */
+    bool run(bool admitted);
+
+    IHttpRequest::Priority priority() const;
+
+   private:
+    Callback callback_;
+    IHttpRequest::Priority priority_;
+    std::weak_ptr<AdmissionController> controller_;
+    bool done_;
+    std::mutex mutex_;
+    std::condition_variable finished_;
+  };
+
+  struct Config {
+    Config();
+
+    /**
+     * Reads concurrency_initial, concurrency_max and concurrency_max_queue
+     * hints.
+     */
+    static Config fromHints(
+        const std::unordered_map<std::string, std::string>&);
+
+    uint32_t initial_window_;
+    uint32_t min_window_;
+
+    /**
+     * Upper bound of the window, 0 disables admission control.
+     */
+    uint32_t max_window_;
+
+    /**
+     * Limit of waiting requests, 0 means unlimited.
+     */
+    uint32_t max_queue_;
+  };
+
+  struct Statistics {
+    double window_;
+    uint32_t in_flight_;
+    uint32_t queued_;
+    uint64_t admitted_;
+    uint64_t rejected_;
+    uint64_t throttled_;
+    uint64_t decreased_;
+
+    /**
+     * Smoothed time to first byte, in seconds.
+     */
+    double latency_;
+  };
+
+  AdmissionController(Config = Config());
+
+  /**
+   * Runs callback right away if there is a free slot in the window, otherwise
+   * once some of in flight requests finish. Admitted request has to be
+   * followed by a call to release.
+   */
+  Ticket::Pointer admit(IHttpRequest::Priority, Callback);
+
+  /**
+   * Frees slot taken by admitted request and adjusts the window.
+   *
+   * @param priority class the request was admitted with
+   * @param code http code / curl error of the response
+   * @param latency time to first byte, in seconds
+   */
+  void release(IHttpRequest::Priority priority, int code, double latency);
+
+  Statistics statistics();
+
+ private:
+  using Queue = std::deque<Ticket::Pointer>;
+
+  void decrease(double factor, std::chrono::steady_clock::time_point now);
+  void remove(const Ticket*);
+
+  /**
+   * Whether request of given class may take a slot now.
+   */
+  bool fits(IHttpRequest::Priority) const;
+  Queue& queue(IHttpRequest::Priority);
+  uint32_t queued() const;
+
+  Config config_;
+  std::mutex mutex_;
+
+  /**
+   * Waiting requests, indexed by priority class.
+   */
+  std::array<Queue, 3> queues_;
+  double window_;
+  uint32_t in_flight_;
+  uint32_t bulk_in_flight_;
+  double fast_latency_;
+  double slow_latency_;
+  std::chrono::steady_clock::time_point next_decrease_;
+  uint64_t admitted_;
+  uint64_t rejected_;
+  uint64_t throttled_;
+  uint64_t decreased_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // ADMISSIONCONTROLLER_H
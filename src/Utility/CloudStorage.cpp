@@ -26,6 +26,7 @@
 #include "CloudProvider/AmazonDrive.h"
 #include "CloudProvider/AmazonS3.h"
 #include "CloudProvider/Box.h"
+#include "CloudProvider/CachedCloudProvider.h"
 #include "CloudProvider/Dropbox.h"
 #include "CloudProvider/GoogleDrive.h"
 #include "CloudProvider/OneDrive.h"
@@ -67,7 +68,11 @@ ICloudProvider::Pointer CloudStorage::provider(
   auto it = providers_.find(name);
   if (it == std::end(providers_)) return nullptr;
   auto ret = it->second();
+  auto hints = init_data.hints_;
   ret->initialize(std::move(init_data));
+  if (hints["metadata_cache"] == "true")
+    return std::make_shared<CachedCloudProvider>(
+        ret, MetadataCache::Config::fromHints(hints));
   return ret;
 }
 
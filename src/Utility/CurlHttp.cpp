@@ -24,13 +24,28 @@
 #include "CurlHttp.h"
 
 #include <json/json.h>
+#include <algorithm>
 #include <array>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 #include "Utility.h"
 
 const uint32_t MAX_URL_LENGTH = 1024;
 const uint32_t POLL_TIMEOUT = 100;
+const uint32_t IDLE_TIMEOUT = 60000;
+const int MAX_EVENTS = 64;
+const uint32_t MAX_STREAMS = 100;
+const uint32_t MAX_BULK_REQUESTS = 8;
 
 namespace cloudstorage {
 
@@ -56,6 +71,32 @@ size_t write_callback(char* ptr, size_t size, size_t nmemb, void* userdata) {
   return size * nmemb;
 }
 
+size_t header_callback(char* buffer, size_t size, size_t nitems,
+                       void* userdata) {
+  RequestData* data = static_cast<RequestData*>(userdata);
+  std::string header(buffer, size * nitems);
+  if (header.compare(0, strlen("HTTP/"), "HTTP/") == 0) {
+    data->response_headers_.clear();
+    return size * nitems;
+  }
+  auto separator = header.find(':');
+  if (separator == std::string::npos) return size * nitems;
+  std::string name = header.substr(0, separator);
+  for (char& c : name)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  auto begin = header.find_first_not_of(" \t", separator + 1);
+  auto end = header.find_last_not_of(" \t\r\n");
+  std::string value = begin == std::string::npos || end < begin
+                          ? ""
+                          : header.substr(begin, end - begin + 1);
+  auto it = data->response_headers_.find(name);
+  if (it == data->response_headers_.end())
+    data->response_headers_[name] = value;
+  else
+    it->second += ", " + value;
+  return size * nitems;
+}
+
 size_t read_callback(char* buffer, size_t size, size_t nmemb, void* userdata) {
   std::istream* stream = static_cast<std::istream*>(userdata);
   stream->read(buffer, size * nmemb);
@@ -78,6 +119,12 @@ int progress_callback(void* clientp, curl_off_t dltotal, curl_off_t dlnow,
   return 0;
 }
 
+std::string host(const std::string& url) {
+  auto begin = url.find("://");
+  begin = begin == std::string::npos ? 0 : begin + strlen("://");
+  return url.substr(begin, url.find_first_of("/?", begin) - begin);
+}
+
 std::ios::pos_type stream_length(std::istream& data) {
   data.seekg(0, data.end);
   std::ios::pos_type length = data.tellg();
@@ -87,51 +134,267 @@ std::ios::pos_type stream_length(std::istream& data) {
 
 }  // namespace
 
-CurlHttp::Worker::Worker() : done_(), thread_(std::bind(&Worker::work, this)) {}
+CurlHttp::Worker::Worker(const Config& config)
+    : engine_(config.engine_),
+      http2_(config.http2_),
+      handle_(curl_multi_init()),
+      epoll_(-1),
+      doorbell_(-1),
+      deadline_(std::chrono::steady_clock::time_point::max()),
+      done_(),
+      load_(),
+      max_requests_(config.max_requests_),
+      max_bulk_requests_(config.max_bulk_requests_),
+      running_() {
+#ifdef __linux__
+  if (engine_ == Engine::Event) {
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    doorbell_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = doorbell_;
+    if (epoll_ == -1 || doorbell_ == -1 ||
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, doorbell_, &event) != 0) {
+      if (epoll_ != -1) close(epoll_);
+      if (doorbell_ != -1) close(doorbell_);
+      epoll_ = doorbell_ = -1;
+      engine_ = Engine::Poll;
+    }
+  }
+#else
+  engine_ = Engine::Poll;
+#endif
+  curl_multi_setopt(handle_, CURLMOPT_PIPELINING,
+                    http2_ ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+  curl_multi_setopt(handle_, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    static_cast<long>(config.max_host_connections_));
+#if LIBCURL_VERSION_NUM >= 0x074300
+  curl_multi_setopt(handle_, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                    static_cast<long>(config.max_streams_));
+#endif
+  if (engine_ == Engine::Event) {
+    curl_multi_setopt(handle_, CURLMOPT_SOCKETFUNCTION, socketCallback);
+    curl_multi_setopt(handle_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(handle_, CURLMOPT_TIMERFUNCTION, timerCallback);
+    curl_multi_setopt(handle_, CURLMOPT_TIMERDATA, this);
+  }
+  thread_ = std::thread(std::bind(&Worker::work, this));
+}
 
 CurlHttp::Worker::~Worker() {
   done_ = true;
-  nonempty_.notify_one();
+  wakeup();
   thread_.join();
+  curl_multi_cleanup(handle_);
+#ifdef __linux__
+  if (epoll_ != -1) close(epoll_);
+  if (doorbell_ != -1) close(doorbell_);
+#endif
 }
 
 void CurlHttp::Worker::work() {
-  auto handle = curl_multi_init();
-  while (!done_ || !pending_.empty()) {
-    std::unique_lock<std::mutex> lock(lock_);
-    nonempty_.wait(lock, [=]() {
-      return done_ || !requests_.empty() || !pending_.empty();
-    });
-    auto requests = std::move(requests_);
-    lock.unlock();
-    for (auto&& r : requests) {
-      curl_multi_add_handle(handle, r->handle_.get());
-      pending_[r->handle_.get()] = std::move(r);
-    }
+  if (engine_ == Engine::Event)
+    eventLoop();
+  else
+    pollLoop();
+}
+
+void CurlHttp::Worker::pollLoop() {
+  auto last_abort_check = std::chrono::steady_clock::now();
+  while (!done_ || !idle()) {
+    start();
     int dummy;
-    curl_multi_perform(handle, &dummy);
-    curl_multi_wait(handle, nullptr, 0, POLL_TIMEOUT, &dummy);
-    CURLMsg* msg;
-    do {
-      msg = curl_multi_info_read(handle, &dummy);
-      if (msg && msg->msg == CURLMSG_DONE) {
-        auto easy_handle = msg->easy_handle;
-        curl_multi_remove_handle(handle, easy_handle);
-        auto it = pending_.find(easy_handle);
-        it->second->done(msg->data.result);
-        pending_.erase(it);
+    curl_multi_perform(handle_, &dummy);
+    finish();
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_abort_check >= std::chrono::milliseconds(POLL_TIMEOUT)) {
+      last_abort_check = now;
+      abort();
+    }
+#if LIBCURL_VERSION_NUM >= 0x074400
+    curl_multi_poll(handle_, nullptr, 0,
+                    pending_.empty() ? IDLE_TIMEOUT : POLL_TIMEOUT, &dummy);
+#else
+    curl_multi_wait(handle_, nullptr, 0, POLL_TIMEOUT, &dummy);
+#endif
+  }
+}
+
+void CurlHttp::Worker::eventLoop() {
+#ifdef __linux__
+  std::array<epoll_event, MAX_EVENTS> events;
+  auto last_abort_check = std::chrono::steady_clock::now();
+  while (!done_ || !idle()) {
+    start();
+    auto now = std::chrono::steady_clock::now();
+    int timeout = -1;
+    if (deadline_ != std::chrono::steady_clock::time_point::max())
+      timeout = static_cast<int>(std::max<int64_t>(
+          0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline_ -
+                                                                   now)
+                 .count()));
+    if (!pending_.empty() &&
+        (timeout == -1 || timeout > static_cast<int>(POLL_TIMEOUT)))
+      timeout = POLL_TIMEOUT;
+    int count = epoll_wait(epoll_, events.data(), MAX_EVENTS, timeout);
+    int running;
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.fd == doorbell_) {
+        uint64_t value;
+        while (read(doorbell_, &value, sizeof(value)) > 0)
+          ;
+        continue;
       }
-    } while (msg);
+      int flags = 0;
+      if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+      if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+      curl_multi_socket_action(handle_, events[i].data.fd, flags, &running);
+    }
+    now = std::chrono::steady_clock::now();
+    if (deadline_ <= now) {
+      deadline_ = std::chrono::steady_clock::time_point::max();
+      curl_multi_socket_action(handle_, CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+    finish();
+    if (now - last_abort_check >= std::chrono::milliseconds(POLL_TIMEOUT)) {
+      last_abort_check = now;
+      abort();
+    }
   }
-  curl_multi_cleanup(handle);
+#endif
+}
+
+void CurlHttp::Worker::start() {
+  std::vector<RequestData::Pointer> requests;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    requests = std::move(requests_);
+  }
+  for (auto&& r : requests)
+    queued_[static_cast<size_t>(r->priority_)].push_back(std::move(r));
+  for (size_t i = 0; i < queued_.size(); i++) {
+    auto& queue = queued_[i];
+    auto limit = static_cast<IHttpRequest::Priority>(i) ==
+                         IHttpRequest::Priority::Bulk
+                     ? max_bulk_requests_
+                     : 0;
+    while (!queue.empty() &&
+           (max_requests_ == 0 || pending_.size() < max_requests_) &&
+           (limit == 0 || running_[i] < limit)) {
+      auto r = std::move(queue.front());
+      queue.pop_front();
+      auto handle = r->handle_.get();
+      pending_[handle] = std::move(r);
+      running_[i]++;
+      curl_multi_add_handle(handle_, handle);
+    }
+  }
+}
+
+void CurlHttp::Worker::finish() {
+  CURLMsg* msg;
+  int dummy;
+  while ((msg = curl_multi_info_read(handle_, &dummy))) {
+    if (msg->msg == CURLMSG_DONE) remove(msg->easy_handle, msg->data.result);
+  }
+}
+
+void CurlHttp::Worker::abort() {
+  std::vector<CURL*> aborted;
+  for (auto&& p : pending_)
+    if (p.second->callback_ && p.second->callback_->abort())
+      aborted.push_back(p.first);
+  for (auto handle : aborted) remove(handle, CURLE_ABORTED_BY_CALLBACK);
+  for (auto&& queue : queued_) {
+    std::deque<RequestData::Pointer> waiting;
+    for (auto&& r : queue)
+      if (r->callback_ && r->callback_->abort()) {
+        r->done(CURLE_ABORTED_BY_CALLBACK);
+        load_--;
+      } else {
+        waiting.push_back(std::move(r));
+      }
+    queue = std::move(waiting);
+  }
+}
+
+void CurlHttp::Worker::remove(CURL* handle, int result) {
+  curl_multi_remove_handle(handle_, handle);
+  auto it = pending_.find(handle);
+  auto data = std::move(it->second);
+  pending_.erase(it);
+  running_[static_cast<size_t>(data->priority_)]--;
+  // requests aborted while queued never used a connection, so only these
+  // are counted
+  if (data->handle_.get_deleter().pool_)
+    data->handle_.get_deleter().pool_->finished(handle);
+  data->done(result);
+  load_--;
+}
+
+bool CurlHttp::Worker::idle() const {
+  return pending_.empty() &&
+         std::all_of(queued_.begin(), queued_.end(),
+                     [](const std::deque<RequestData::Pointer>& queue) {
+                       return queue.empty();
+                     });
 }
 
 void CurlHttp::Worker::add(RequestData::Pointer r) {
+  load_++;
   {
     std::lock_guard<std::mutex> lock(lock_);
     requests_.push_back(std::move(r));
   }
-  nonempty_.notify_all();
+  wakeup();
+}
+
+void CurlHttp::Worker::wakeup() {
+#ifdef __linux__
+  if (engine_ == Engine::Event) {
+    uint64_t value = 1;
+    ssize_t ret = write(doorbell_, &value, sizeof(value));
+    (void)ret;
+    return;
+  }
+#endif
+#if LIBCURL_VERSION_NUM >= 0x074400
+  curl_multi_wakeup(handle_);
+#endif
+}
+
+int CurlHttp::Worker::socketCallback(CURL*, curl_socket_t socket, int what,
+                                     void* userp, void*) {
+#ifdef __linux__
+  auto worker = static_cast<Worker*>(userp);
+  if (what == CURL_POLL_REMOVE) {
+    epoll_ctl(worker->epoll_, EPOLL_CTL_DEL, socket, nullptr);
+  } else {
+    epoll_event event = {};
+    if (what & CURL_POLL_IN) event.events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) event.events |= EPOLLOUT;
+    event.data.fd = socket;
+    if (epoll_ctl(worker->epoll_, EPOLL_CTL_MOD, socket, &event) != 0 &&
+        errno == ENOENT)
+      epoll_ctl(worker->epoll_, EPOLL_CTL_ADD, socket, &event);
+  }
+#else
+  (void)socket;
+  (void)what;
+  (void)userp;
+#endif
+  return 0;
+}
+
+int CurlHttp::Worker::timerCallback(CURLM*, long timeout_ms, void* userp) {
+  auto worker = static_cast<Worker*>(userp);
+  if (timeout_ms < 0)
+    worker->deadline_ = std::chrono::steady_clock::time_point::max();
+  else
+    worker->deadline_ = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+  return 0;
 }
 
 void RequestData::done(int code) {
@@ -155,28 +418,55 @@ void RequestData::done(int code) {
     *error_stream_ << curl_easy_strerror(static_cast<CURLcode>(code));
     ret = (code == CURLE_ABORTED_BY_CALLBACK) ? IHttpRequest::Aborted : -code;
   }
-  complete_({ret, content_length, stream_, error_stream_});
+  IHttpRequest::Timing timing = {};
+  curl_easy_getinfo(handle_.get(), CURLINFO_NAMELOOKUP_TIME,
+                    &timing.name_lookup_);
+  curl_easy_getinfo(handle_.get(), CURLINFO_CONNECT_TIME, &timing.connect_);
+  curl_easy_getinfo(handle_.get(), CURLINFO_APPCONNECT_TIME,
+                    &timing.tls_handshake_);
+  curl_easy_getinfo(handle_.get(), CURLINFO_STARTTRANSFER_TIME,
+                    &timing.start_transfer_);
+  curl_easy_getinfo(handle_.get(), CURLINFO_TOTAL_TIME, &timing.total_);
+  complete_({ret, content_length, stream_, error_stream_,
+             std::move(response_headers_), timing});
 }
 
 CurlHttpRequest::CurlHttpRequest(const std::string& url,
                                  const std::string& method,
                                  bool follow_redirect,
-                                 std::shared_ptr<CurlHttp::Worker> worker)
+                                 std::shared_ptr<CurlHttp::Worker> worker,
+                                 HandlePool::Pointer pool)
     : url_(url),
       method_(method),
       follow_redirect_(follow_redirect),
-      worker_(worker) {}
+      priority_(Priority::Normal),
+      worker_(worker),
+      pool_(pool) {}
 
 std::unique_ptr<CURL, CurlDeleter> CurlHttpRequest::init() const {
-  std::unique_ptr<CURL, CurlDeleter> handle(curl_easy_init());
+  auto handle = pool_->get();
   curl_easy_setopt(handle.get(), CURLOPT_WRITEFUNCTION, write_callback);
   curl_easy_setopt(handle.get(), CURLOPT_READFUNCTION, read_callback);
+  curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, header_callback);
   curl_easy_setopt(handle.get(), CURLOPT_SSL_VERIFYPEER,
                    static_cast<long>(false));
   curl_easy_setopt(handle.get(), CURLOPT_FOLLOWLOCATION,
                    static_cast<long>(follow_redirect_));
   curl_easy_setopt(handle.get(), CURLOPT_XFERINFOFUNCTION, progress_callback);
   curl_easy_setopt(handle.get(), CURLOPT_NOPROGRESS, static_cast<long>(false));
+  if (worker_->http2_) {
+    curl_easy_setopt(handle.get(), CURLOPT_HTTP_VERSION,
+                     static_cast<long>(CURL_HTTP_VERSION_2TLS));
+    curl_easy_setopt(handle.get(), CURLOPT_PIPEWAIT, static_cast<long>(true));
+#if LIBCURL_VERSION_NUM >= 0x072e00
+    const long weight[] = {256, 16, 1};
+    curl_easy_setopt(handle.get(), CURLOPT_STREAM_WEIGHT,
+                     weight[static_cast<size_t>(priority_)]);
+#endif
+  } else {
+    curl_easy_setopt(handle.get(), CURLOPT_HTTP_VERSION,
+                     static_cast<long>(CURL_HTTP_VERSION_1_1));
+  }
   std::string parameters = parametersToString();
   std::string url = url_ + (!parameters.empty() ? ("?" + parameters) : "");
   curl_easy_setopt(handle.get(), CURLOPT_URL, url.c_str());
@@ -209,6 +499,10 @@ const std::string& CurlHttpRequest::url() const { return url_; }
 
 const std::string& CurlHttpRequest::method() const { return method_; }
 
+void CurlHttpRequest::setPriority(Priority priority) { priority_ = priority; }
+
+IHttpRequest::Priority CurlHttpRequest::priority() const { return priority_; }
+
 RequestData::Pointer CurlHttpRequest::prepare(
     CompleteCallback complete, std::shared_ptr<std::istream> data,
     std::shared_ptr<std::ostream> response,
@@ -216,9 +510,10 @@ RequestData::Pointer CurlHttpRequest::prepare(
     ICallback::Pointer callback) const {
   auto cb_data = util::make_unique<RequestData>(RequestData{
       init(), headerParametersToList(), data, response, error_stream, callback,
-      complete, follow_redirect(), true, false});
+      complete, follow_redirect(), true, false, {}, priority_});
   auto handle = cb_data->handle_.get();
   curl_easy_setopt(handle, CURLOPT_WRITEDATA, cb_data.get());
+  curl_easy_setopt(handle, CURLOPT_HEADERDATA, cb_data.get());
   curl_easy_setopt(handle, CURLOPT_XFERINFODATA, callback.get());
   curl_easy_setopt(handle, CURLOPT_READDATA, data.get());
   curl_easy_setopt(handle, CURLOPT_HTTPHEADER, cb_data->headers_.get());
@@ -269,19 +564,182 @@ CurlHttpRequest::headerParametersToList() const {
   return std::unique_ptr<curl_slist, CurlListDeleter>(list);
 }
 
-void CurlDeleter::operator()(CURL* handle) const { curl_easy_cleanup(handle); }
+void CurlDeleter::operator()(CURL* handle) const {
+  if (pool_)
+    pool_->release(handle);
+  else
+    curl_easy_cleanup(handle);
+}
 
 void CurlListDeleter::operator()(curl_slist* lst) const {
   curl_slist_free_all(lst);
 }
 
-CurlHttp::CurlHttp() : worker_(std::make_shared<Worker>()) {}
+Share::Share() : handle_(curl_share_init()) {
+  curl_share_setopt(handle_, CURLSHOPT_LOCKFUNC, lock);
+  curl_share_setopt(handle_, CURLSHOPT_UNLOCKFUNC, unlock);
+  curl_share_setopt(handle_, CURLSHOPT_USERDATA, this);
+  curl_share_setopt(handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(handle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+Share::~Share() { curl_share_cleanup(handle_); }
+
+CURLSH* Share::handle() const { return handle_; }
+
+Share::Pointer Share::instance() {
+  static std::mutex mutex;
+  static std::weak_ptr<Share> instance;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto result = instance.lock();
+  if (!result) {
+    result = std::make_shared<Share>();
+    instance = result;
+  }
+  return result;
+}
+
+void Share::lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+  static_cast<Share*>(userptr)->lock_[data].lock();
+}
+
+void Share::unlock(CURL*, curl_lock_data data, void* userptr) {
+  static_cast<Share*>(userptr)->lock_[data].unlock();
+}
+
+constexpr uint32_t HandlePool::MAX_SIZE;
+
+HandlePool::HandlePool(Share::Pointer share)
+    : share_(share),
+      handles_created_(),
+      handles_reused_(),
+      connections_created_(),
+      connections_reused_() {}
+
+HandlePool::~HandlePool() {
+  for (auto handle : handles_) curl_easy_cleanup(handle);
+}
+
+std::unique_ptr<CURL, CurlDeleter> HandlePool::get() {
+  CURL* handle = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!handles_.empty()) {
+      handle = handles_.back();
+      handles_.pop_back();
+    }
+  }
+  if (handle) {
+    handles_reused_++;
+  } else {
+    handle = curl_easy_init();
+    handles_created_++;
+  }
+  curl_easy_setopt(handle, CURLOPT_SHARE, share_->handle());
+  return std::unique_ptr<CURL, CurlDeleter>(handle,
+                                            CurlDeleter{shared_from_this()});
+}
+
+void HandlePool::release(CURL* handle) {
+  curl_easy_reset(handle);
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (handles_.size() < MAX_SIZE) return handles_.push_back(handle);
+  }
+  curl_easy_cleanup(handle);
+}
+
+void HandlePool::finished(CURL* handle) {
+  long connections = 0;
+  curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connections);
+  if (connections > 0)
+    connections_created_ += connections;
+  else
+    connections_reused_++;
+}
+
+HandlePool::Statistics HandlePool::statistics() const {
+  return {handles_created_, handles_reused_, connections_created_,
+          connections_reused_};
+}
+
+CurlHttp::Config::Config()
+    : engine_(Engine::Event),
+      workers_(1),
+      balance_(Balance::LeastLoaded),
+      process_share_(true),
+      http2_(true),
+      max_host_connections_(0),
+      max_streams_(MAX_STREAMS),
+      max_requests_(0),
+      max_bulk_requests_(MAX_BULK_REQUESTS) {}
+
+CurlHttp::Config CurlHttp::Config::fromHints(
+    const std::unordered_map<std::string, std::string>& hints) {
+  Config config;
+  auto it = hints.find("http_engine");
+  if (it != hints.end() && it->second == "poll") config.engine_ = Engine::Poll;
+  it = hints.find("http_workers");
+  if (it != hints.end()) {
+    config.workers_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+    if (config.workers_ == 0)
+      config.workers_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+  it = hints.find("http_balance");
+  if (it != hints.end() && it->second == "host")
+    config.balance_ = Balance::HostAffinity;
+  it = hints.find("http_share");
+  if (it != hints.end() && it->second == "instance")
+    config.process_share_ = false;
+  it = hints.find("http2");
+  if (it != hints.end() && it->second == "false") config.http2_ = false;
+  it = hints.find("http_max_host_connections");
+  if (it != hints.end())
+    config.max_host_connections_ =
+        static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("http_max_streams");
+  if (it != hints.end() && std::atoi(it->second.c_str()) > 0)
+    config.max_streams_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("http_max_requests");
+  if (it != hints.end())
+    config.max_requests_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("http_max_bulk_requests");
+  if (it != hints.end())
+    config.max_bulk_requests_ =
+        static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  return config;
+}
+
+CurlHttp::CurlHttp(Config config)
+    : balance_(config.balance_),
+      pool_(std::make_shared<HandlePool>(config.process_share_
+                                             ? Share::instance()
+                                             : std::make_shared<Share>())) {
+  for (uint32_t i = 0; i < std::max(1u, config.workers_); i++)
+    workers_.push_back(std::make_shared<Worker>(config));
+}
 
 IHttpRequest::Pointer CurlHttp::create(const std::string& url,
                                        const std::string& method,
                                        bool follow_redirect) const {
   return util::make_unique<CurlHttpRequest>(url, method, follow_redirect,
-                                            worker_);
+                                            worker(url), pool_);
+}
+
+HandlePool::Statistics CurlHttp::statistics() const {
+  return pool_->statistics();
+}
+
+std::shared_ptr<CurlHttp::Worker> CurlHttp::worker(
+    const std::string& url) const {
+  if (workers_.size() == 1) return workers_.front();
+  if (balance_ == Balance::HostAffinity)
+    return workers_[std::hash<std::string>()(host(url)) % workers_.size()];
+  return *std::min_element(workers_.begin(), workers_.end(),
+                           [](const std::shared_ptr<Worker>& w1,
+                              const std::shared_ptr<Worker>& w2) {
+                             return w1->load_ < w2->load_;
+                           });
 }
 
 }  // namespace curl
@@ -25,9 +25,12 @@
 #define CURLHTTP_H
 
 #include <curl/curl.h>
+#include <array>
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -39,8 +42,12 @@ namespace cloudstorage {
 
 namespace curl {
 
+class HandlePool;
+
 struct CurlDeleter {
   void operator()(CURL*) const;
+
+  std::shared_ptr<HandlePool> pool_;
 };
 
 struct CurlListDeleter {
@@ -60,36 +67,200 @@ struct RequestData {
   bool follow_redirect_;
   bool first_call_;
   bool success_;
+  IHttpRequest::HeaderParameters response_headers_;
+  IHttpRequest::Priority priority_;
 
   void done(int result);
 };
 
+/**
+ * Wraps CURLSH object which shares dns cache and tls sessions between easy
+ * handles, possibly running on different threads.
+ */
+class Share {
+ public:
+  using Pointer = std::shared_ptr<Share>;
+
+  Share();
+  ~Share();
+
+  CURLSH* handle() const;
+
+  /**
+   * @return share object used by all CurlHttp instances in the process
+   */
+  static Pointer instance();
+
+ private:
+  static void lock(CURL*, curl_lock_data, curl_lock_access, void* userptr);
+  static void unlock(CURL*, curl_lock_data, void* userptr);
+
+  CURLSH* handle_;
+  std::array<std::mutex, CURL_LOCK_DATA_LAST> lock_;
+};
+
+/**
+ * Keeps easy handles of finished requests, so that next requests don't have
+ * to allocate them again.
+ */
+class HandlePool : public std::enable_shared_from_this<HandlePool> {
+ public:
+  using Pointer = std::shared_ptr<HandlePool>;
+
+  static constexpr uint32_t MAX_SIZE = 64;
+
+  struct Statistics {
+    uint64_t handles_created_;
+    uint64_t handles_reused_;
+    uint64_t connections_created_;
+    uint64_t connections_reused_;
+  };
+
+  HandlePool(Share::Pointer);
+  ~HandlePool();
+
+  std::unique_ptr<CURL, CurlDeleter> get();
+  void release(CURL*);
+
+  /**
+   * Updates connection reuse counters with data of finished transfer.
+   */
+  void finished(CURL*);
+
+  Statistics statistics() const;
+
+ private:
+  Share::Pointer share_;
+  std::mutex lock_;
+  std::vector<CURL*> handles_;
+  std::atomic<uint64_t> handles_created_;
+  std::atomic<uint64_t> handles_reused_;
+  std::atomic<uint64_t> connections_created_;
+  std::atomic<uint64_t> connections_reused_;
+};
+
 class CurlHttp : public IHttp {
  public:
-  CurlHttp();
+  /**
+   * Poll drives transfers with curl_multi_perform and curl_multi_poll; Event
+   * uses curl_multi_socket_action with epoll and is available on linux only,
+   * elsewhere it falls back to Poll.
+   */
+  enum class Engine { Poll, Event };
+
+  /**
+   * Decides which worker runs a request: LeastLoaded picks the worker with
+   * the fewest requests in flight, HostAffinity keeps all requests to the
+   * same host on one worker so they can reuse its connections.
+   */
+  enum class Balance { LeastLoaded, HostAffinity };
+
+  struct Config {
+    Config();
+
+    /**
+     * Reads http_engine, http_workers, http_balance, http_share, http2,
+     * http_max_host_connections, http_max_streams, http_max_requests and
+     * http_max_bulk_requests hints.
+     */
+    static Config fromHints(
+        const std::unordered_map<std::string, std::string>&);
+
+    Engine engine_;
+    uint32_t workers_;
+    Balance balance_;
+
+    /**
+     * Whether dns cache and tls sessions are shared with other CurlHttp
+     * instances in the process.
+     */
+    bool process_share_;
+
+    /**
+     * Negotiates http/2 over tls and multiplexes concurrent requests to the
+     * same host over one connection; servers which don't support it are
+     * talked to with http/1.1.
+     */
+    bool http2_;
+
+    /**
+     * Limit of connections per host per worker, 0 means no limit.
+     */
+    uint32_t max_host_connections_;
+
+    /**
+     * Limit of concurrent http/2 streams per connection.
+     */
+    uint32_t max_streams_;
+
+    /**
+     * Limit of requests running at once per worker, 0 means no limit; when
+     * it's reached, waiting requests are started in order of their priority.
+     */
+    uint32_t max_requests_;
+
+    /**
+     * Limit of bulk requests running at once per worker, 0 means no limit.
+     */
+    uint32_t max_bulk_requests_;
+  };
+
+  CurlHttp(Config = Config());
 
   IHttpRequest::Pointer create(const std::string&, const std::string&,
                                bool) const override;
 
+  HandlePool::Statistics statistics() const;
+
  private:
   friend class CurlHttpRequest;
 
   struct Worker {
-    Worker();
+    Worker(const Config&);
     ~Worker();
 
     void work();
+    void pollLoop();
+    void eventLoop();
     void add(RequestData::Pointer r);
+    void wakeup();
+    void start();
+    void finish();
+    void abort();
+    void remove(CURL*, int result);
+    bool idle() const;
+
+    static int socketCallback(CURL*, curl_socket_t, int what, void* userp,
+                              void*);
+    static int timerCallback(CURLM*, long timeout_ms, void* userp);
 
+    Engine engine_;
+    bool http2_;
+    CURLM* handle_;
+    int epoll_;
+    int doorbell_;
+    std::chrono::steady_clock::time_point deadline_;
     std::atomic_bool done_;
-    std::condition_variable nonempty_;
+    std::atomic<uint32_t> load_;
+    uint32_t max_requests_;
+    uint32_t max_bulk_requests_;
     std::vector<RequestData::Pointer> requests_;
+
+    /**
+     * Requests waiting for a free slot, indexed by priority.
+     */
+    std::array<std::deque<RequestData::Pointer>, 3> queued_;
+    std::array<uint32_t, 3> running_;
     std::unordered_map<CURL*, RequestData::Pointer> pending_;
     std::mutex lock_;
     std::thread thread_;
   };
 
-  std::shared_ptr<Worker> worker_;
+  std::shared_ptr<Worker> worker(const std::string& url) const;
+
+  Balance balance_;
+  HandlePool::Pointer pool_;
+  std::vector<std::shared_ptr<Worker>> workers_;
 };
 
 class CurlHttpRequest : public IHttpRequest,
@@ -97,7 +268,8 @@ class CurlHttpRequest : public IHttpRequest,
  public:
   CurlHttpRequest(const std::string& url, const std::string& method,
                   bool follow_redirect,
-                  std::shared_ptr<CurlHttp::Worker> worker);
+                  std::shared_ptr<CurlHttp::Worker> worker,
+                  HandlePool::Pointer pool);
   std::unique_ptr<CURL, CurlDeleter> init() const;
 
   void setParameter(const std::string& parameter,
@@ -114,6 +286,9 @@ class CurlHttpRequest : public IHttpRequest,
   const std::string& method() const override;
   bool follow_redirect() const override;
 
+  void setPriority(Priority) override;
+  Priority priority() const override;
+
   RequestData::Pointer prepare(CompleteCallback,
                                std::shared_ptr<std::istream> data,
                                std::shared_ptr<std::ostream> response,
@@ -135,7 +310,9 @@ class CurlHttpRequest : public IHttpRequest,
   std::unordered_map<std::string, std::string> header_parameters_;
   std::string method_;
   bool follow_redirect_;
+  Priority priority_;
   std::shared_ptr<CurlHttp::Worker> worker_;
+  HandlePool::Pointer pool_;
 };
 
 }  // namespace curl
@@ -76,9 +76,25 @@ size_t Item::size() const { return size_; }
 
 void Item::set_size(size_t size) { size_ = size; }
 
-std::string Item::url() const { return url_; }
+std::string Item::url() const {
+  std::lock_guard<std::mutex> lock(url_mutex_);
+  if (url_resolver_) {
+    url_ = url_resolver_(*this);
+    url_resolver_ = nullptr;
+  }
+  return url_;
+}
+
+void Item::set_url(std::string url) {
+  std::lock_guard<std::mutex> lock(url_mutex_);
+  url_ = url;
+  url_resolver_ = nullptr;
+}
 
-void Item::set_url(std::string url) { url_ = url; }
+void Item::set_url_resolver(UrlResolver resolver) {
+  std::lock_guard<std::mutex> lock(url_mutex_);
+  url_resolver_ = std::move(resolver);
+}
 
 std::string Item::thumbnail_url() const { return thumbnail_url_; }
 
@@ -24,6 +24,8 @@
 #ifndef ITEM_H
 #define ITEM_H
 
+#include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -34,6 +36,7 @@ namespace cloudstorage {
 class Item : public IItem {
  public:
   using Pointer = std::shared_ptr<Item>;
+  using UrlResolver = std::function<std::string(const Item&)>;
 
   Item(std::string filename, std::string id, size_t size, FileType);
 
@@ -49,6 +52,12 @@ class Item : public IItem {
   std::string url() const override;
   void set_url(std::string);
 
+  /**
+   * Sets function which computes the url on first call to url(), for
+   * providers for which it's costly, e.g. has to be signed.
+   */
+  void set_url_resolver(UrlResolver);
+
   std::string thumbnail_url() const;
   void set_thumbnail_url(std::string);
 
@@ -67,7 +76,9 @@ class Item : public IItem {
  private:
   std::string filename_;
   std::string id_;
-  std::string url_;
+  mutable std::string url_;
+  mutable UrlResolver url_resolver_;
+  mutable std::mutex url_mutex_;
   size_t size_;
   std::string thumbnail_url_;
   FileType type_;
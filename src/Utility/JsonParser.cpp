@@ -0,0 +1,195 @@
+/*****************************************************************************
+ * JsonParser.cpp : JsonParser implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "JsonParser.h"
+
+#include <algorithm>
+
+const size_t READ_SIZE = 16 * 1024;
+
+namespace cloudstorage {
+namespace util {
+
+namespace {
+
+bool isWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}  // namespace
+
+JsonParser::JsonParser(std::vector<std::string> expanded, Callback callback)
+    : expanded_(std::move(expanded)),
+      callback_(callback),
+      state_(State::Value),
+      depth_(),
+      scalar_(),
+      string_(),
+      escape_() {}
+
+void JsonParser::write(const char* data, size_t length) {
+  for (size_t i = 0; i < length && state_ != State::Failed; i++) {
+    if (state_ == State::Capture || state_ == State::KeyString)
+      capture(data[i]);
+    else
+      structure(data[i]);
+  }
+}
+
+void JsonParser::write(std::istream& stream) {
+  char buffer[READ_SIZE];
+  while (state_ != State::Failed) {
+    auto read = stream.rdbuf()->sgetn(buffer, READ_SIZE);
+    if (read <= 0) break;
+    write(buffer, static_cast<size_t>(read));
+  }
+}
+
+bool JsonParser::finish() const { return state_ == State::Done; }
+
+void JsonParser::structure(char c) {
+  if (isWhitespace(c)) return;
+  switch (state_) {
+    case State::ValueOrEnd:
+      if (c == ']') return endContainer(c);
+    // fall through
+    case State::Value:
+      return startValue(c);
+    case State::KeyOrEnd:
+      if (c == '}') return endContainer(c);
+    // fall through
+    case State::Key:
+      if (c != '"') return fail();
+      key_ = c;
+      string_ = true;
+      escape_ = false;
+      state_ = State::KeyString;
+      return;
+    case State::Colon:
+      if (c != ':') return fail();
+      state_ = State::Value;
+      return;
+    case State::CommaOrEnd:
+      if (c == ',')
+        state_ = frames_.back().object_ ? State::Key : State::Value;
+      else
+        endContainer(c);
+      return;
+    default:
+      return fail();
+  }
+}
+
+void JsonParser::capture(char c) {
+  std::string& buffer = state_ == State::KeyString ? key_ : capture_;
+  if (string_) {
+    buffer += c;
+    if (escape_)
+      escape_ = false;
+    else if (c == '\\')
+      escape_ = true;
+    else if (c == '"') {
+      string_ = false;
+      if (state_ == State::KeyString) {
+        Json::Value key;
+        if (!reader_.parse(key_, key, false) || !key.isString())
+          return fail();
+        key_ = key.asString();
+        state_ = State::Colon;
+      } else if (depth_ == 0) {
+        endCapture();
+      }
+    }
+  } else if (scalar_) {
+    if (c == ',' || c == '}' || c == ']' || isWhitespace(c)) {
+      endCapture();
+      if (state_ != State::Failed) structure(c);
+    } else {
+      buffer += c;
+    }
+  } else {
+    buffer += c;
+    if (c == '"') {
+      string_ = true;
+    } else if (c == '{' || c == '[') {
+      depth_++;
+    } else if (c == '}' || c == ']') {
+      if (--depth_ == 0) endCapture();
+    }
+  }
+}
+
+void JsonParser::startValue(char c) {
+  std::string path;
+  if (!frames_.empty()) {
+    path = frames_.back().path_;
+    if (frames_.back().object_) path += (path.empty() ? "" : "/") + key_;
+  }
+  bool element = !frames_.empty() && !frames_.back().object_;
+  if ((c == '{' || c == '[') && !element &&
+      std::find(expanded_.begin(), expanded_.end(), path) != expanded_.end()) {
+    frames_.push_back({c == '{', path});
+    state_ = c == '{' ? State::KeyOrEnd : State::ValueOrEnd;
+    return;
+  }
+  state_ = State::Capture;
+  capture_ = c;
+  capture_path_ = path;
+  depth_ = c == '{' || c == '[' ? 1 : 0;
+  string_ = c == '"';
+  escape_ = false;
+  scalar_ = !string_ && depth_ == 0;
+}
+
+void JsonParser::endCapture() {
+  JsonView value;
+  if (!document_.parse(capture_, value)) return fail();
+  try {
+    callback_(capture_path_, value);
+  } catch (...) {
+    return fail();
+  }
+  capture_.clear();
+  scalar_ = false;
+  endValue();
+}
+
+void JsonParser::endContainer(char c) {
+  if (frames_.empty() || c != (frames_.back().object_ ? '}' : ']'))
+    return fail();
+  frames_.pop_back();
+  endValue();
+}
+
+void JsonParser::endValue() {
+  state_ = frames_.empty() ? State::Done : State::CommaOrEnd;
+}
+
+void JsonParser::fail() {
+  state_ = State::Failed;
+  frames_.clear();
+  capture_.clear();
+}
+
+}  // namespace util
+}  // namespace cloudstorage
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * JsonParser.h : JsonParser headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef JSONPARSER_H
+#define JSONPARSER_H
+
+#include <json/json.h>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "JsonView.h"
+
+namespace cloudstorage {
+namespace util {
+
+/**
+ * Push parser for json responses of cloud providers. Objects and arrays at
+ * expanded paths are walked through as they arrive; every other value is
+ * parsed by JsonDocument on its own as soon as it ends. That way a listing
+ * whose entries are elements of an expanded array is never held in memory
+ * whole. Path of a value is made of member names joined with '/', elements
+ * of an array share array's path and are never expanded; the root's path is
+ * empty.
+ */
+class JsonParser {
+ public:
+  using Callback =
+      std::function<void(const std::string& path, const JsonView&)>;
+
+  /**
+   * @param expanded paths of containers whose members are reported separately
+   * @param callback called with every value which isn't expanded; the value
+   * is valid only during the call
+   */
+  JsonParser(std::vector<std::string> expanded, Callback callback);
+
+  /**
+   * Parses next chunk of the document. Doesn't throw; an exception thrown by
+   * the callback marks the document as invalid instead.
+   */
+  void write(const char* data, size_t length);
+
+  /**
+   * Parses whole stream.
+   */
+  void write(std::istream&);
+
+  /**
+   * @return whether the document was complete and well formed
+   */
+  bool finish() const;
+
+ private:
+  enum class State {
+    Value,
+    ValueOrEnd,
+    Key,
+    KeyOrEnd,
+    KeyString,
+    Colon,
+    CommaOrEnd,
+    Capture,
+    Done,
+    Failed
+  };
+
+  struct Frame {
+    bool object_;
+    std::string path_;
+  };
+
+  void structure(char);
+  void capture(char);
+  void startValue(char);
+  void endCapture();
+  void endContainer(char);
+  void endValue();
+  void fail();
+
+  std::vector<std::string> expanded_;
+  Callback callback_;
+  Json::Reader reader_;
+  JsonDocument document_;
+  State state_;
+  std::vector<Frame> frames_;
+  std::string key_;
+  std::string capture_;
+  std::string capture_path_;
+  int depth_;
+  bool scalar_;
+  bool string_;
+  bool escape_;
+};
+
+}  // namespace util
+}  // namespace cloudstorage
+
+#endif  // JSONPARSER_H
@@ -0,0 +1,300 @@
+/*****************************************************************************
+ * JsonView.cpp : JsonView implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "JsonView.h"
+
+#include <json/json.h>
+#include <new>
+#include <stdexcept>
+
+#ifdef WITH_SIMDJSON
+#include <simdjson.h>
+#include <type_traits>
+#endif
+
+namespace cloudstorage {
+namespace util {
+
+#ifdef WITH_SIMDJSON
+
+namespace {
+
+using simdjson::dom::element_type;
+
+Json::Value toJson(simdjson::dom::element e) {
+  switch (e.type()) {
+    case element_type::ARRAY: {
+      Json::Value result(Json::arrayValue);
+      simdjson::dom::array array = e.get_array().value_unsafe();
+      for (auto child : array) result.append(toJson(child));
+      return result;
+    }
+    case element_type::OBJECT: {
+      Json::Value result(Json::objectValue);
+      simdjson::dom::object object = e.get_object().value_unsafe();
+      for (auto member : object)
+        result[std::string(member.key)] = toJson(member.value);
+      return result;
+    }
+    case element_type::INT64:
+      return Json::Int64(e.get_int64().value_unsafe());
+    case element_type::UINT64:
+      return Json::UInt64(e.get_uint64().value_unsafe());
+    case element_type::DOUBLE:
+      return e.get_double().value_unsafe();
+    case element_type::STRING:
+      return std::string(e.get_string().value_unsafe());
+    case element_type::BOOL:
+      return e.get_bool().value_unsafe();
+    default:
+      return Json::Value();
+  }
+}
+
+/**
+ * Converts scalar to Json::Value, so that conversions between types are the
+ * same for both backends; containers are converted to empty ones, which is
+ * enough for their conversions to fail the same way.
+ */
+Json::Value scalar(simdjson::dom::element e) {
+  switch (e.type()) {
+    case element_type::ARRAY:
+      return Json::Value(Json::arrayValue);
+    case element_type::OBJECT:
+      return Json::Value(Json::objectValue);
+    default:
+      return toJson(e);
+  }
+}
+
+}  // namespace
+
+struct JsonView::Element {
+  static_assert(sizeof(simdjson::dom::element) <= sizeof(JsonView::element_),
+                "simdjson::dom::element doesn't fit in JsonView");
+  static_assert(std::is_trivially_copyable<simdjson::dom::element>::value,
+                "simdjson::dom::element isn't trivially copyable");
+
+  static simdjson::dom::element get(const JsonView& view) {
+    return *reinterpret_cast<const simdjson::dom::element*>(view.element_);
+  }
+
+  static JsonView make(simdjson::dom::element e) {
+    JsonView result;
+    if (e.is_null()) return result;
+    result.kind_ = Kind::Element;
+    new (result.element_) simdjson::dom::element(e);
+    return result;
+  }
+
+  static bool object(simdjson::dom::element e) {
+    if (e.is_object()) return true;
+    if (e.is_null()) return false;
+    throw std::logic_error("json value isn't an object");
+  }
+
+  static simdjson::simdjson_result<simdjson::dom::element> find(
+      const JsonView& view, const char* key) {
+    auto e = get(view);
+    if (!object(e)) return simdjson::NO_SUCH_FIELD;
+    return e.get_object().value_unsafe().at_key(key);
+  }
+};
+
+#endif  // WITH_SIMDJSON
+
+JsonView::JsonView() : kind_(Kind::Null), value_(), element_() {}
+
+JsonView::JsonView(const Json::Value& value)
+    : kind_(Kind::Value), value_(&value), element_() {}
+
+JsonView JsonView::operator[](const char* key) const {
+  switch (kind_) {
+    case Kind::Value:
+      return (*value_)[key];
+#ifdef WITH_SIMDJSON
+    case Kind::Element: {
+      auto result = Element::find(*this, key);
+      if (result.error()) return {};
+      return Element::make(result.value_unsafe());
+    }
+#endif
+    default:
+      return {};
+  }
+}
+
+JsonView JsonView::operator[](const std::string& key) const {
+  return (*this)[key.c_str()];
+}
+
+bool JsonView::isMember(const char* key) const {
+  switch (kind_) {
+    case Kind::Value:
+      return value_->isMember(key);
+#ifdef WITH_SIMDJSON
+    case Kind::Element:
+      return !Element::find(*this, key).error();
+#endif
+    default:
+      return false;
+  }
+}
+
+bool JsonView::isNull() const {
+  return kind_ == Kind::Null || (kind_ == Kind::Value && value_->isNull());
+}
+
+std::string JsonView::asString() const {
+  switch (kind_) {
+    case Kind::Value:
+      return value_->asString();
+#ifdef WITH_SIMDJSON
+    case Kind::Element: {
+      auto e = Element::get(*this);
+      if (e.is_string()) return std::string(e.get_string().value_unsafe());
+      return scalar(e).asString();
+    }
+#endif
+    default:
+      return "";
+  }
+}
+
+uint64_t JsonView::asUInt64() const {
+  switch (kind_) {
+    case Kind::Value:
+      return value_->asUInt64();
+#ifdef WITH_SIMDJSON
+    case Kind::Element:
+      return scalar(Element::get(*this)).asUInt64();
+#endif
+    default:
+      return 0;
+  }
+}
+
+int JsonView::asInt() const {
+  switch (kind_) {
+    case Kind::Value:
+      return value_->asInt();
+#ifdef WITH_SIMDJSON
+    case Kind::Element:
+      return scalar(Element::get(*this)).asInt();
+#endif
+    default:
+      return 0;
+  }
+}
+
+bool JsonView::asBool() const {
+  switch (kind_) {
+    case Kind::Value:
+      return value_->asBool();
+#ifdef WITH_SIMDJSON
+    case Kind::Element:
+      return scalar(Element::get(*this)).asBool();
+#endif
+    default:
+      return false;
+  }
+}
+
+JsonView::Array JsonView::elements() const {
+  Array result;
+  switch (kind_) {
+    case Kind::Value:
+      for (const auto& child : *value_) result.push_back(child);
+      break;
+#ifdef WITH_SIMDJSON
+    case Kind::Element: {
+      auto e = Element::get(*this);
+      if (e.is_array()) {
+        simdjson::dom::array array = e.get_array().value_unsafe();
+        for (auto child : array) result.push_back(Element::make(child));
+      } else if (e.is_object()) {
+        simdjson::dom::object object = e.get_object().value_unsafe();
+        for (auto member : object)
+          result.push_back(Element::make(member.value));
+      }
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+  return result;
+}
+
+Json::Value JsonView::toValue() const {
+  switch (kind_) {
+    case Kind::Value:
+      return *value_;
+#ifdef WITH_SIMDJSON
+    case Kind::Element:
+      return toJson(Element::get(*this));
+#endif
+    default:
+      return Json::Value();
+  }
+}
+
+#ifdef WITH_SIMDJSON
+
+struct JsonDocument::Data {
+  simdjson::dom::parser parser_;
+};
+
+bool JsonDocument::parse(std::string& text, JsonView& result) {
+  text.reserve(text.size() + simdjson::SIMDJSON_PADDING);
+  auto root = data_->parser_.parse(text.data(), text.size(), false);
+  if (root.error()) return false;
+  result = JsonView::Element::make(root.value_unsafe());
+  return true;
+}
+
+const char* JsonDocument::backend() { return "simdjson"; }
+
+#else
+
+struct JsonDocument::Data {
+  Json::Reader reader_;
+  Json::Value root_;
+};
+
+bool JsonDocument::parse(std::string& text, JsonView& result) {
+  if (!data_->reader_.parse(text, data_->root_, false)) return false;
+  result = data_->root_;
+  return true;
+}
+
+const char* JsonDocument::backend() { return "jsoncpp"; }
+
+#endif  // WITH_SIMDJSON
+
+JsonDocument::JsonDocument() : data_(new Data) {}
+
+JsonDocument::~JsonDocument() {}
+
+}  // namespace util
+}  // namespace cloudstorage
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * JsonView.h : JsonView headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef JSONVIEW_H
+#define JSONVIEW_H
+
+#include <json/forwards.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cloudstorage {
+namespace util {
+
+/**
+ * Read-only access to a json value, which is either a Json::Value or a value
+ * parsed by JsonDocument with the backend chosen at configure time (simdjson
+ * when built with --with-simdjson, jsoncpp otherwise). Accessors behave like
+ * their Json::Value counterparts: missing members are null and null converts
+ * to empty string, zero or false.
+ *
+ * View doesn't own the value; it's valid as long as the value it was created
+ * from.
+ */
+class JsonView {
+ public:
+  using Array = std::vector<JsonView>;
+
+  /**
+   * Creates null value.
+   */
+  JsonView();
+  JsonView(const Json::Value&);
+
+  JsonView operator[](const char* key) const;
+  JsonView operator[](const std::string& key) const;
+
+  bool isMember(const char* key) const;
+  bool isNull() const;
+
+  std::string asString() const;
+  uint64_t asUInt64() const;
+  int asInt() const;
+  bool asBool() const;
+
+  /**
+   * @return elements of an array or member values of an object
+   */
+  Array elements() const;
+
+  /**
+   * @return deep copy of the value
+   */
+  Json::Value toValue() const;
+
+ private:
+  friend class JsonDocument;
+  struct Element;
+
+  enum class Kind { Null, Value, Element };
+
+  Kind kind_;
+  const Json::Value* value_;
+  alignas(void*) unsigned char element_[2 * sizeof(void*)];
+};
+
+/**
+ * Parses json documents with the configured backend. Buffers are reused
+ * between documents, so a single instance should be kept for many of them.
+ */
+class JsonDocument {
+ public:
+  JsonDocument();
+  ~JsonDocument();
+
+  /**
+   * Parses text; text may be reallocated to make room for the backend's
+   * padding.
+   *
+   * @param result set to document's root; valid until next call to parse
+   * @return whether text was well formed
+   */
+  bool parse(std::string& text, JsonView& result);
+
+  /**
+   * @return name of the backend
+   */
+  static const char* backend();
+
+ private:
+  struct Data;
+  std::unique_ptr<Data> data_;
+};
+
+}  // namespace util
+}  // namespace cloudstorage
+
+#endif  // JSONVIEW_H
@@ -0,0 +1,293 @@
+/*****************************************************************************
+ * MetadataCache.cpp : MetadataCache implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "MetadataCache.h"
+
+#include <cstdlib>
+
+namespace cloudstorage {
+
+namespace {
+
+const uint32_t TTL = 60000;
+const uint32_t STALE = 300000;
+const uint32_t MAX_ENTRIES = 4096;
+const uint64_t MAX_BYTES = 64 * 1024 * 1024;
+
+// rough size of item's remaining fields and of cache's bookkeeping
+const uint64_t ITEM_SIZE = 256;
+
+uint64_t size(const IItem& item) {
+  return ITEM_SIZE + item.id().size() + item.filename().size();
+}
+
+std::string listingKey(const std::string& id) { return "l" + id; }
+
+std::string itemKey(const std::string& id) { return "i" + id; }
+
+}  // namespace
+
+MetadataCache::Config::Config()
+    : ttl_(TTL), stale_(STALE), max_entries_(MAX_ENTRIES),
+      max_bytes_(MAX_BYTES) {}
+
+MetadataCache::Config MetadataCache::Config::fromHints(
+    const std::unordered_map<std::string, std::string>& hints) {
+  Config config;
+  auto it = hints.find("metadata_cache_ttl");
+  if (it != hints.end())
+    config.ttl_ = std::chrono::milliseconds(std::atoll(it->second.c_str()));
+  it = hints.find("metadata_cache_stale");
+  if (it != hints.end())
+    config.stale_ = std::chrono::milliseconds(std::atoll(it->second.c_str()));
+  it = hints.find("metadata_cache_entries");
+  if (it != hints.end() && std::atoi(it->second.c_str()) > 0)
+    config.max_entries_ = static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  it = hints.find("metadata_cache_bytes");
+  if (it != hints.end() && std::atoll(it->second.c_str()) > 0)
+    config.max_bytes_ = static_cast<uint64_t>(std::atoll(it->second.c_str()));
+  it = hints.find("metadata_cache_snapshot");
+  if (it != hints.end()) config.snapshot_ = it->second;
+  return config;
+}
+
+MetadataCache::MetadataCache(Config config)
+    : config_(config),
+      snapshot_(config.snapshot_.empty()
+                    ? nullptr
+                    : std::make_shared<MetadataSnapshot>(config.snapshot_,
+                                                         config.restore_)),
+      generation_(),
+      forgotten_(),
+      bytes_(),
+      hits_(),
+      stale_hits_(),
+      misses_(),
+      snapshot_hits_(),
+      evicted_() {}
+
+MetadataCache::State MetadataCache::getListing(
+    const std::string& id, std::vector<IItem::Pointer>& result) {
+  auto state = get(listingKey(id), result);
+  if (state != State::Missing || !snapshot_) return state;
+  uint64_t generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (config_.ttl_.count() <= 0) return State::Missing;
+    generation = generation_;
+  }
+  flush();
+  if (!snapshot_->getListing(id, result)) return State::Missing;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // listing could be invalidated while it was read
+  if (!current(listingKey(id), generation)) return State::Missing;
+  snapshot_hits_++;
+  // it's unknown when the listing was saved, so it's fetched again right away
+  if (index_.find(listingKey(id)) == index_.end())
+    insert(Entry{listingKey(id), id, true,
+                 std::chrono::steady_clock::now() - config_.ttl_, 0, result});
+  return State::Stale;
+}
+
+MetadataCache::State MetadataCache::getItem(const std::string& id,
+                                            IItem::Pointer& result) {
+  std::vector<IItem::Pointer> items;
+  auto state = get(itemKey(id), items);
+  if (state != State::Missing) result = items.front();
+  return state;
+}
+
+uint64_t MetadataCache::generation() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return generation_;
+}
+
+void MetadataCache::putListing(const std::string& id,
+                               const std::vector<IItem::Pointer>& items,
+                               uint64_t generation) {
+  put(Entry{listingKey(id), id, true, {}, 0, items}, generation);
+}
+
+void MetadataCache::putItem(IItem::Pointer item, uint64_t generation) {
+  put(Entry{itemKey(item->id()), item->id(), false, {}, 0, {item}},
+      generation);
+}
+
+void MetadataCache::remove(const std::string& id,
+                           const std::vector<std::string>& parents) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    auto directories = parents;
+    auto range = parents_.equal_range(id);
+    for (auto it = range.first; it != range.second; ++it)
+      directories.push_back(it->second);
+    for (const auto& directory : directories) {
+      invalidate(listingKey(directory));
+      if (snapshot_) snapshot_writes_.push_back({directory, true, {}});
+    }
+    invalidate(itemKey(id));
+    eraseTree(id);
+  }
+  flush();
+}
+
+void MetadataCache::changed(const std::string& id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    invalidate(listingKey(id));
+    if (snapshot_) snapshot_writes_.push_back({id, true, {}});
+  }
+  flush();
+}
+
+MetadataCache::Statistics MetadataCache::statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {hits_,          stale_hits_,
+          misses_,        snapshot_hits_,
+          evicted_,       static_cast<uint32_t>(entries_.size()),
+          bytes_};
+}
+
+MetadataCache::State MetadataCache::get(const std::string& key,
+                                        std::vector<IItem::Pointer>& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config_.ttl_.count() <= 0) return State::Missing;
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    misses_++;
+    return State::Missing;
+  }
+  auto entry = it->second;
+  auto age = std::chrono::steady_clock::now() - entry->updated_;
+  if (age >= config_.ttl_ + config_.stale_) {
+    erase(entry);
+    misses_++;
+    return State::Missing;
+  }
+  entries_.splice(entries_.begin(), entries_, entry);
+  result = entry->items_;
+  if (age >= config_.ttl_) {
+    stale_hits_++;
+    return State::Stale;
+  }
+  hits_++;
+  return State::Fresh;
+}
+
+void MetadataCache::put(Entry&& entry, uint64_t generation) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (config_.ttl_.count() <= 0 || !current(entry.key_, generation)) return;
+    if (entry.listing_ && snapshot_)
+      snapshot_writes_.push_back({entry.id_, false, entry.items_});
+    entry.updated_ = std::chrono::steady_clock::now();
+    insert(std::move(entry));
+  }
+  flush();
+}
+
+bool MetadataCache::current(const std::string& key,
+                            uint64_t generation) const {
+  if (generation < forgotten_) return false;
+  auto it = invalidated_.find(key);
+  return it == invalidated_.end() || it->second <= generation;
+}
+
+void MetadataCache::insert(Entry&& entry) {
+  erase(entry.key_);
+  entry.bytes_ = ITEM_SIZE + entry.key_.size();
+  for (const auto& item : entry.items_) entry.bytes_ += size(*item);
+  if (entry.bytes_ > config_.max_bytes_) return;
+  if (entry.listing_)
+    for (const auto& item : entry.items_)
+      parents_.insert({item->id(), entry.id_});
+  bytes_ += entry.bytes_;
+  entries_.push_front(std::move(entry));
+  index_[entries_.front().key_] = entries_.begin();
+  while (!entries_.empty() && (entries_.size() > config_.max_entries_ ||
+                               bytes_ > config_.max_bytes_)) {
+    erase(std::prev(entries_.end()));
+    evicted_++;
+  }
+}
+
+void MetadataCache::erase(EntryList::iterator entry) {
+  if (entry->listing_)
+    for (const auto& item : entry->items_) {
+      auto range = parents_.equal_range(item->id());
+      for (auto it = range.first; it != range.second; ++it)
+        if (it->second == entry->id_) {
+          parents_.erase(it);
+          break;
+        }
+    }
+  bytes_ -= entry->bytes_;
+  index_.erase(entry->key_);
+  entries_.erase(entry);
+}
+
+void MetadataCache::erase(const std::string& key) {
+  auto it = index_.find(key);
+  if (it != index_.end()) erase(it->second);
+}
+
+void MetadataCache::eraseTree(const std::string& id) {
+  if (snapshot_) snapshot_writes_.push_back({id, true, {}});
+  auto it = index_.find(listingKey(id));
+  std::vector<std::string> directories;
+  if (it != index_.end())
+    for (const auto& item : it->second->items_)
+      if (item->type() == IItem::FileType::Directory)
+        directories.push_back(item->id());
+  invalidate(listingKey(id));
+  for (const auto& directory : directories) eraseTree(directory);
+}
+
+void MetadataCache::invalidate(const std::string& key) {
+  erase(key);
+  if (invalidated_.size() >= config_.max_entries_) {
+    invalidated_.clear();
+    forgotten_ = generation_;
+  } else {
+    invalidated_[key] = generation_;
+  }
+}
+
+void MetadataCache::flush() {
+  if (!snapshot_) return;
+  std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
+  std::vector<SnapshotWrite> writes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    writes.swap(snapshot_writes_);
+  }
+  for (const auto& write : writes)
+    if (write.remove_)
+      snapshot_->remove(write.id_);
+    else
+      snapshot_->putListing(write.id_, write.items_);
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,213 @@
+/*****************************************************************************
+ * MetadataCache.h : MetadataCache headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IItem.h"
+#include "MetadataSnapshot.h"
+
+namespace cloudstorage {
+
+/**
+ * Least recently used directory listings and items' metadata, bounded by
+ * count of entries and their estimated size in bytes. Entries are fresh for
+ * ttl; for the following stale period they're still returned, but they should
+ * be fetched again. Listings may be also saved to MetadataSnapshot, so that
+ * they're available in the next session.
+ */
+class MetadataCache {
+ public:
+  using Pointer = std::shared_ptr<MetadataCache>;
+
+  struct Config {
+    Config();
+
+    /**
+     * Reads metadata_cache_ttl, metadata_cache_stale,
+     * metadata_cache_entries, metadata_cache_bytes and
+     * metadata_cache_snapshot hints.
+     */
+    static Config fromHints(
+        const std::unordered_map<std::string, std::string>&);
+
+    /**
+     * How long entries are fresh, 0 disables the cache.
+     */
+    std::chrono::milliseconds ttl_;
+
+    /**
+     * How long entries are served after ttl while they're fetched again.
+     */
+    std::chrono::milliseconds stale_;
+
+    uint32_t max_entries_;
+    uint64_t max_bytes_;
+
+    /**
+     * Path of MetadataSnapshot listings are saved to, empty by default.
+     */
+    std::string snapshot_;
+
+    /**
+     * Called on items read from snapshot, see MetadataSnapshot.
+     */
+    MetadataSnapshot::Restore restore_;
+  };
+
+  struct Statistics {
+    uint64_t hits_;
+    uint64_t stale_hits_;
+    uint64_t misses_;
+
+    /**
+     * Misses served from snapshot, they're returned as stale.
+     */
+    uint64_t snapshot_hits_;
+    uint64_t evicted_;
+    uint32_t entries_;
+    uint64_t bytes_;
+  };
+
+  enum class State { Missing, Fresh, Stale };
+
+  MetadataCache(Config = Config());
+
+  /**
+   * Listings which aren't in memory are looked up in snapshot.
+   */
+  State getListing(const std::string& id, std::vector<IItem::Pointer>& result);
+  State getItem(const std::string& id, IItem::Pointer& result);
+
+  /**
+   * Entries fetched by requests started before the entry was last
+   * invalidated are dropped, so that put methods take generation read when
+   * the request was started.
+   */
+  uint64_t generation();
+
+  void putListing(const std::string& id, const std::vector<IItem::Pointer>&,
+                  uint64_t generation);
+  void putItem(IItem::Pointer, uint64_t generation);
+
+  /**
+   * Forgets item's metadata, its listing with listings of its descendants
+   * and listings of directories containing it; called once item was deleted,
+   * moved or renamed.
+   *
+   * @param parents ids of directories known to contain the item, their
+   * listings are forgotten even if they're only in snapshot
+   */
+  void remove(const std::string& id, const std::vector<std::string>& parents);
+
+  /**
+   * Forgets listing of directory; called once an item was created in it.
+   */
+  void changed(const std::string& id);
+
+  Statistics statistics();
+
+ private:
+  struct Entry {
+    std::string key_;
+    std::string id_;
+    bool listing_;
+    std::chrono::steady_clock::time_point updated_;
+    uint64_t bytes_;
+    std::vector<IItem::Pointer> items_;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  /**
+   * Listing to save to snapshot, or to remove from it if remove_ is set.
+   */
+  struct SnapshotWrite {
+    std::string id_;
+    bool remove_;
+    std::vector<IItem::Pointer> items_;
+  };
+
+  State get(const std::string& key, std::vector<IItem::Pointer>& result);
+  void put(Entry&&, uint64_t generation);
+  bool current(const std::string& key, uint64_t generation) const;
+  void insert(Entry&&);
+  void erase(EntryList::iterator);
+  void erase(const std::string& key);
+  void eraseTree(const std::string& id);
+  void invalidate(const std::string& key);
+
+  /**
+   * Does snapshot writes queued so far; it's called with mutex_ unlocked,
+   * so that file io doesn't block the cache.
+   */
+  void flush();
+
+  Config config_;
+  MetadataSnapshot::Pointer snapshot_;
+  std::mutex mutex_;
+
+  /**
+   * Held by flush, so that writes are done in order they were queued.
+   */
+  std::mutex snapshot_mutex_;
+  std::vector<SnapshotWrite> snapshot_writes_;
+
+  /**
+   * Most recently used entries first.
+   */
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+
+  /**
+   * Ids of cached listings, by ids of items they contain.
+   */
+  std::unordered_multimap<std::string, std::string> parents_;
+  uint64_t generation_;
+
+  /**
+   * Generations in which keys were last invalidated. Once there are more of
+   * them than max_entries_, they're forgotten and all entries fetched before
+   * are dropped.
+   */
+  std::unordered_map<std::string, uint64_t> invalidated_;
+  uint64_t forgotten_;
+  uint64_t bytes_;
+  uint64_t hits_;
+  uint64_t stale_hits_;
+  uint64_t misses_;
+  uint64_t snapshot_hits_;
+  uint64_t evicted_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // METADATACACHE_H
@@ -0,0 +1,483 @@
+/*****************************************************************************
+ * MetadataSnapshot.cpp : MetadataSnapshot implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "MetadataSnapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#include "Utility/Item.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cloudstorage {
+
+namespace {
+
+const char MAGIC[] = "csmetadt";
+const uint32_t ENDIANNESS = 0x01020304;
+const uint64_t COMPACT_SIZE = 1024 * 1024;
+const uint64_t UNKNOWN_SIZE = std::numeric_limits<uint64_t>::max();
+
+enum RecordType : uint32_t { STRING = 1, LISTING = 2, REMOVED = 3 };
+
+struct FileHeader {
+  char magic_[8];
+  uint32_t version_;
+  uint32_t byte_order_;
+};
+
+/**
+ * Followed by length bytes of payload; length is a multiple of 8, so that
+ * records stay aligned.
+ */
+struct RecordHeader {
+  uint32_t type_;
+  uint32_t length_;
+};
+
+/**
+ * Listing's payload is directory's id and count of items, both uint64_t,
+ * followed by item records; string's payload is its uint32_t length followed
+ * by its bytes; removed record's payload is directory's id.
+ */
+struct ItemRecord {
+  uint64_t id_;
+  uint64_t filename_;
+  uint64_t parents_;
+  uint64_t size_;
+  uint32_t type_;
+  uint32_t hidden_;
+};
+
+FileHeader fileHeader() {
+  FileHeader header;
+  std::memcpy(header.magic_, MAGIC, sizeof(header.magic_));
+  header.version_ = MetadataSnapshot::FORMAT_VERSION;
+  header.byte_order_ = ENDIANNESS;
+  return header;
+}
+
+uint64_t hash(const char* data, size_t length) {
+  uint64_t result = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    result ^= static_cast<unsigned char>(data[i]);
+    result *= 1099511628211ULL;
+  }
+  return result;
+}
+
+template <class T>
+void appendValue(std::string& output, const T& value) {
+  output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void appendRecord(std::string& output, uint32_t type,
+                  const std::string& payload) {
+  RecordHeader header{type, static_cast<uint32_t>((payload.size() + 7) & ~7)};
+  appendValue(output, header);
+  output += payload;
+  output.append(header.length_ - payload.size(), '\0');
+}
+
+std::string parents(const IItem& item) {
+  std::string result;
+  auto i = dynamic_cast<const Item*>(&item);
+  if (!i) return result;
+  for (const auto& parent : i->parents()) {
+    if (!result.empty()) result += '\0';
+    result += parent;
+  }
+  return result;
+}
+
+std::vector<std::string> split(const std::string& parents) {
+  std::vector<std::string> result;
+  if (parents.empty()) return result;
+  size_t begin = 0, end;
+  while ((end = parents.find('\0', begin)) != std::string::npos) {
+    result.push_back(parents.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  result.push_back(parents.substr(begin));
+  return result;
+}
+
+}  // namespace
+
+MetadataSnapshot::MetadataSnapshot(const std::string& path, Restore restore)
+    : path_(path),
+      restore_(restore),
+      loaded_(),
+      fd_(-1),
+      data_(),
+      mapped_(),
+      size_(),
+      live_(),
+      dead_() {}
+
+MetadataSnapshot::~MetadataSnapshot() {
+  unmap();
+#ifndef _WIN32
+  if (fd_ != -1) close(fd_);
+#endif
+}
+
+bool MetadataSnapshot::getListing(const std::string& id,
+                                  std::vector<IItem::Pointer>& result) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  load();
+  auto it = listings_.find(id);
+  if (it == listings_.end() || !decode(it->second, result)) return false;
+  if (restore_)
+    for (const auto& item : result) restore_(static_cast<Item&>(*item));
+  return true;
+}
+
+void MetadataSnapshot::putListing(const std::string& id,
+                                  const std::vector<IItem::Pointer>& items) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  load();
+  if (fd_ == -1 || !map()) return;
+  std::string output;
+  StringMap added;
+  auto payload = encode(id, items, output, size_, added, true);
+  if (payload.size() > std::numeric_limits<uint32_t>::max()) return;
+  auto it = listings_.find(id);
+  if (output.empty() && it != listings_.end() &&
+      it->second.bytes_ == sizeof(RecordHeader) + payload.size() &&
+      std::memcmp(data_ + it->second.offset_ + sizeof(RecordHeader),
+                  payload.data(), payload.size()) == 0)
+    return;
+  Listing listing{size_ + output.size(),
+                  sizeof(RecordHeader) + payload.size()};
+  appendRecord(output, LISTING, payload);
+  if (!append(output)) return;
+  for (const auto& string : added)
+    strings_.insert({hash(string.first.data(), string.first.size()),
+                     string.second});
+  if (it != listings_.end()) {
+    live_ -= it->second.bytes_;
+    dead_ += it->second.bytes_;
+  }
+  listings_[id] = listing;
+  live_ += listing.bytes_;
+}
+
+void MetadataSnapshot::remove(const std::string& id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  load();
+  auto it = listings_.find(id);
+  if (it == listings_.end() || !map()) return;
+  std::string output;
+  appendRecord(output, REMOVED,
+               std::string(data_ + it->second.offset_ + sizeof(RecordHeader),
+                           sizeof(uint64_t)));
+  if (!append(output)) return;
+  live_ -= it->second.bytes_;
+  dead_ += it->second.bytes_ + output.size();
+  listings_.erase(it);
+}
+
+void MetadataSnapshot::load() {
+  if (loaded_) return;
+  loaded_ = true;
+#ifndef _WIN32
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ == -1) return;
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  size_ = static_cast<uint64_t>(st.st_size);
+  FileHeader header, expected = fileHeader();
+  if (size_ < sizeof(header) ||
+      pread(fd_, &header, sizeof(header), 0) != sizeof(header) ||
+      std::memcmp(&header, &expected, sizeof(header)) != 0)
+    return reset();
+  scan();
+  if (dead_ > live_ && size_ > COMPACT_SIZE) compact();
+#endif
+}
+
+void MetadataSnapshot::reset() {
+#ifndef _WIN32
+  unmap();
+  listings_.clear();
+  strings_.clear();
+  live_ = dead_ = 0;
+  auto header = fileHeader();
+  if (ftruncate(fd_, 0) != 0 ||
+      pwrite(fd_, &header, sizeof(header), 0) != sizeof(header)) {
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  size_ = sizeof(header);
+#endif
+}
+
+void MetadataSnapshot::scan() {
+  if (!map()) return reset();
+  uint64_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= size_) {
+    RecordHeader header;
+    std::memcpy(&header, data_ + offset, sizeof(header));
+    auto end = offset + sizeof(RecordHeader) + header.length_;
+    auto payload = data_ + offset + sizeof(RecordHeader);
+    if (end > size_ || header.length_ % 8 != 0) break;
+    uint32_t length;
+    if (header.type_ == STRING) {
+      auto string = this->string(offset, length);
+      if (!string) break;
+      strings_.insert({hash(string, length), offset});
+    } else if (header.type_ == LISTING || header.type_ == REMOVED) {
+      uint64_t directory, count = 0;
+      if (header.length_ < sizeof(directory)) break;
+      std::memcpy(&directory, payload, sizeof(directory));
+      auto id = directory < offset ? string(directory, length) : nullptr;
+      if (!id) break;
+      if (header.type_ == LISTING) {
+        if (header.length_ < 2 * sizeof(uint64_t)) break;
+        std::memcpy(&count, payload + sizeof(directory), sizeof(count));
+        if (header.length_ != 2 * sizeof(uint64_t) + count * sizeof(ItemRecord))
+          break;
+      }
+      std::string key(id, length);
+      auto it = listings_.find(key);
+      if (it != listings_.end()) {
+        live_ -= it->second.bytes_;
+        dead_ += it->second.bytes_;
+        listings_.erase(it);
+      }
+      if (header.type_ == LISTING) {
+        listings_[key] = {offset, end - offset};
+        live_ += end - offset;
+      } else {
+        dead_ += end - offset;
+      }
+    } else {
+      break;
+    }
+    offset = end;
+  }
+#ifndef _WIN32
+  // the rest is what was left by an interrupted write
+  if (offset != size_) {
+    if (ftruncate(fd_, static_cast<off_t>(offset)) != 0) {
+      unmap();
+      close(fd_);
+      fd_ = -1;
+      return;
+    }
+    size_ = offset;
+    map();
+  }
+#endif
+}
+
+void MetadataSnapshot::compact() {
+#ifndef _WIN32
+  auto header = fileHeader();
+  std::string output;
+  appendValue(output, header);
+  StringMap strings;
+  std::unordered_map<std::string, Listing> listings;
+  uint64_t live = 0;
+  for (const auto& l : listings_) {
+    std::vector<IItem::Pointer> items;
+    if (!decode(l.second, items)) continue;
+    auto payload = encode(l.first, items, output, 0, strings, false);
+    Listing listing{output.size(), sizeof(RecordHeader) + payload.size()};
+    appendRecord(output, LISTING, payload);
+    listings[l.first] = listing;
+    live += listing.bytes_;
+  }
+  auto path = path_ + ".tmp";
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) return;
+  size_t written = 0;
+  while (written < output.size()) {
+    auto count = write(fd, output.data() + written, output.size() - written);
+    if (count <= 0) break;
+    written += static_cast<size_t>(count);
+  }
+  if (close(fd) != 0 || written != output.size() ||
+      rename(path.c_str(), path_.c_str()) != 0) {
+    unlink(path.c_str());
+    return;
+  }
+  unmap();
+  close(fd_);
+  fd_ = open(path_.c_str(), O_RDWR);
+  size_ = output.size();
+  listings_ = std::move(listings);
+  strings_.clear();
+  for (const auto& string : strings)
+    strings_.insert({hash(string.first.data(), string.first.size()),
+                     string.second});
+  live_ = live;
+  dead_ = 0;
+#endif
+}
+
+bool MetadataSnapshot::map() {
+#ifndef _WIN32
+  if (data_ && mapped_ == size_) return true;
+  unmap();
+  if (fd_ == -1 || size_ == 0) return false;
+  auto data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(data);
+  mapped_ = size_;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MetadataSnapshot::unmap() {
+#ifndef _WIN32
+  if (data_) munmap(const_cast<char*>(data_), mapped_);
+#endif
+  data_ = nullptr;
+  mapped_ = 0;
+}
+
+bool MetadataSnapshot::append(const std::string& data) {
+#ifndef _WIN32
+  size_t written = 0;
+  while (written < data.size()) {
+    auto count = pwrite(fd_, data.data() + written, data.size() - written,
+                        static_cast<off_t>(size_ + written));
+    if (count <= 0) {
+      // file is left as it is, scan drops incomplete records
+      unmap();
+      close(fd_);
+      fd_ = -1;
+      return false;
+    }
+    written += static_cast<size_t>(count);
+  }
+  size_ += data.size();
+  return true;
+#else
+  return false;
+#endif
+}
+
+const char* MetadataSnapshot::string(uint64_t offset, uint32_t& length) {
+  RecordHeader header;
+  if (offset + sizeof(RecordHeader) + sizeof(length) > mapped_) return nullptr;
+  std::memcpy(&header, data_ + offset, sizeof(header));
+  std::memcpy(&length, data_ + offset + sizeof(header), sizeof(length));
+  if (header.type_ != STRING ||
+      offset + sizeof(header) + header.length_ > mapped_ ||
+      sizeof(length) + static_cast<uint64_t>(length) > header.length_)
+    return nullptr;
+  return data_ + offset + sizeof(header) + sizeof(length);
+}
+
+bool MetadataSnapshot::decode(const Listing& listing,
+                              std::vector<IItem::Pointer>& result) {
+  if (!map()) return false;
+  auto payload = data_ + listing.offset_ + sizeof(RecordHeader);
+  uint64_t count;
+  std::memcpy(&count, payload + sizeof(uint64_t), sizeof(count));
+  auto records =
+      reinterpret_cast<const ItemRecord*>(payload + 2 * sizeof(uint64_t));
+  std::vector<IItem::Pointer> items;
+  items.reserve(count);
+  for (uint64_t i = 0; i < count; i++) {
+    const auto& record = records[i];
+    uint32_t id_length, filename_length, parents_length;
+    auto id = string(record.id_, id_length);
+    auto filename = string(record.filename_, filename_length);
+    auto parents = string(record.parents_, parents_length);
+    if (!id || !filename || !parents ||
+        record.type_ > static_cast<uint32_t>(IItem::FileType::Unknown))
+      return false;
+    auto item = std::make_shared<Item>(
+        std::string(filename, filename_length), std::string(id, id_length),
+        record.size_ == UNKNOWN_SIZE ? IItem::UnknownSize
+                                     : static_cast<size_t>(record.size_),
+        static_cast<IItem::FileType>(record.type_));
+    item->set_hidden(record.hidden_ != 0);
+    item->set_parents(split(std::string(parents, parents_length)));
+    items.push_back(item);
+  }
+  result = std::move(items);
+  return true;
+}
+
+std::string MetadataSnapshot::encode(const std::string& id,
+                                     const std::vector<IItem::Pointer>& items,
+                                     std::string& output, uint64_t base,
+                                     StringMap& added, bool interned) {
+  auto intern = [&](const std::string& value) {
+    uint32_t length;
+    auto range = std::make_pair(strings_.end(), strings_.end());
+    if (interned)
+      range = strings_.equal_range(hash(value.data(), value.size()));
+    for (auto it = range.first; it != range.second; ++it) {
+      auto string = this->string(it->second, length);
+      if (string && length == value.size() &&
+          std::memcmp(string, value.data(), length) == 0)
+        return it->second;
+    }
+    auto it = added.find(value);
+    if (it != added.end()) return it->second;
+    uint64_t offset = base + output.size();
+    std::string payload;
+    appendValue(payload, static_cast<uint32_t>(value.size()));
+    payload += value;
+    appendRecord(output, STRING, payload);
+    added[value] = offset;
+    return offset;
+  };
+  std::string payload;
+  appendValue(payload, intern(id));
+  appendValue(payload, static_cast<uint64_t>(items.size()));
+  for (const auto& item : items) {
+    ItemRecord record;
+    record.id_ = intern(item->id());
+    record.filename_ = intern(item->filename());
+    record.parents_ = intern(parents(*item));
+    record.size_ =
+        item->size() == IItem::UnknownSize ? UNKNOWN_SIZE : item->size();
+    record.type_ = static_cast<uint32_t>(item->type());
+    record.hidden_ = item->is_hidden();
+    appendValue(payload, record);
+  }
+  return payload;
+}
+
+}  // namespace cloudstorage
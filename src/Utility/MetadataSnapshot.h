@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * MetadataSnapshot.h : MetadataSnapshot headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef METADATASNAPSHOT_H
+#define METADATASNAPSHOT_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IItem.h"
+
+namespace cloudstorage {
+
+class Item;
+
+/**
+ * Directory listings kept on disk between sessions. File starts with a
+ * header holding format's version and byte order, files with different ones
+ * are discarded. Then there are records appended one after another:
+ *  - string, referred to by its offset in the file; every string is stored
+ *    once and shared by all records using it,
+ *  - listing, directory's id and a fixed size record of each child,
+ *  - removed, directory's id whose listing isn't valid anymore.
+ * Later records supersede earlier ones. File is mapped in memory and indexed
+ * on first use; it's rewritten then if most of it was superseded. Items read
+ * from the file don't have urls nor thumbnail urls, restore callback may set
+ * what the provider can derive itself, e.g. url resolvers. File shouldn't be
+ * shared by processes nor providers.
+ */
+class MetadataSnapshot {
+ public:
+  using Pointer = std::shared_ptr<MetadataSnapshot>;
+
+  using Restore = std::function<void(Item&)>;
+
+  static const uint32_t FORMAT_VERSION = 1;
+
+  MetadataSnapshot(const std::string& path, Restore = nullptr);
+  ~MetadataSnapshot();
+
+  bool getListing(const std::string& id, std::vector<IItem::Pointer>& result);
+
+  /**
+   * Appends listing unless it's the same as the stored one.
+   */
+  void putListing(const std::string& id, const std::vector<IItem::Pointer>&);
+  void remove(const std::string& id);
+
+ private:
+  struct Listing {
+    uint64_t offset_;
+    uint64_t bytes_;
+  };
+
+  using StringMap = std::unordered_map<std::string, uint64_t>;
+
+  void load();
+  void reset();
+  void scan();
+  void compact();
+  bool map();
+  void unmap();
+  bool append(const std::string& data);
+
+  const char* string(uint64_t offset, uint32_t& length);
+  bool decode(const Listing&, std::vector<IItem::Pointer>& result);
+
+  /**
+   * Returns listing's record; strings which aren't in the file yet are
+   * appended to output, which starts at offset base.
+   */
+  std::string encode(const std::string& id,
+                     const std::vector<IItem::Pointer>& items,
+                     std::string& output, uint64_t base, StringMap& added,
+                     bool interned);
+
+  std::string path_;
+  Restore restore_;
+  std::mutex mutex_;
+  bool loaded_;
+  int fd_;
+  const char* data_;
+  uint64_t mapped_;
+  uint64_t size_;
+  std::unordered_map<std::string, Listing> listings_;
+
+  /**
+   * Offsets of strings by their hashes.
+   */
+  std::unordered_multimap<uint64_t, uint64_t> strings_;
+  uint64_t live_;
+  uint64_t dead_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // METADATASNAPSHOT_H
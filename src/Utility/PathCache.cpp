@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * PathCache.cpp : PathCache implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "PathCache.h"
+
+#include <cstdlib>
+
+namespace cloudstorage {
+
+namespace {
+
+const uint32_t TTL = 10000;
+const uint32_t MAX_DIRECTORIES = 1024;
+
+}  // namespace
+
+PathCache::Config::Config()
+    : ttl_(TTL), max_directories_(MAX_DIRECTORIES) {}
+
+PathCache::Config PathCache::Config::fromHints(
+    const std::unordered_map<std::string, std::string>& hints) {
+  Config config;
+  auto it = hints.find("path_cache_ttl");
+  if (it != hints.end())
+    config.ttl_ = std::chrono::milliseconds(std::atoll(it->second.c_str()));
+  it = hints.find("path_cache_size");
+  if (it != hints.end() && std::atoi(it->second.c_str()) > 0)
+    config.max_directories_ =
+        static_cast<uint32_t>(std::atoi(it->second.c_str()));
+  return config;
+}
+
+PathCache::PathCache(Config config) : config_(config), hits_(), misses_() {}
+
+bool PathCache::lookup(const std::string& path, const IItem& directory,
+                       const std::string& name, IItem::Pointer& found) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config_.ttl_.count() <= 0) return false;
+  auto it = directories_.find(path);
+  if (it == directories_.end() || it->second.id_ != directory.id()) {
+    misses_++;
+    return false;
+  }
+  if (std::chrono::steady_clock::now() - it->second.listed_ >= config_.ttl_) {
+    erase(it);
+    misses_++;
+    return false;
+  }
+  auto child = it->second.children_.find(name);
+  found = child == it->second.children_.end() ? nullptr : child->second;
+  hits_++;
+  return true;
+}
+
+void PathCache::add(const std::string& path, const IItem& directory,
+                    const std::vector<IItem::Pointer>& children) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config_.ttl_.count() <= 0) return;
+  auto it = directories_.find(path);
+  if (it != directories_.end()) erase(it);
+  while (!directories_.empty() &&
+         directories_.size() >= config_.max_directories_) {
+    auto oldest = directories_.begin();
+    for (auto it = directories_.begin(); it != directories_.end(); ++it)
+      if (it->second.listed_ < oldest->second.listed_) oldest = it;
+    erase(oldest);
+  }
+  Directory entry{directory.id(), std::chrono::steady_clock::now(), {}};
+  for (const auto& child : children)
+    if (entry.children_.emplace(child->filename(), child).second)
+      paths_.emplace(child->id(), path + "/" + child->filename());
+  directories_.emplace(path, std::move(entry));
+}
+
+void PathCache::remove(const IItem& item) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::string> paths;
+  auto range = paths_.equal_range(item.id());
+  for (auto it = range.first; it != range.second; ++it)
+    paths.push_back(it->second);
+  for (const auto& directory : directories_)
+    if (directory.second.id_ == item.id()) paths.push_back(directory.first);
+  for (const auto& path : paths) {
+    if (!path.empty()) {
+      auto parent = directories_.find(path.substr(0, path.find_last_of('/')));
+      if (parent != directories_.end()) erase(parent);
+    }
+    eraseTree(path);
+  }
+}
+
+void PathCache::changed(const IItem& directory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = directories_.begin(); it != directories_.end();)
+    if (it->second.id_ == directory.id())
+      erase(it++);
+    else
+      ++it;
+}
+
+PathCache::Statistics PathCache::statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {hits_, misses_, static_cast<uint32_t>(directories_.size())};
+}
+
+void PathCache::erase(DirectoryMap::iterator directory) {
+  for (const auto& child : directory->second.children_) {
+    auto path = directory->first + "/" + child.first;
+    auto range = paths_.equal_range(child.second->id());
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second == path) {
+        paths_.erase(it);
+        break;
+      }
+  }
+  directories_.erase(directory);
+}
+
+void PathCache::eraseTree(const std::string& path) {
+  auto it = directories_.find(path);
+  if (it != directories_.end()) erase(it);
+  auto prefix = path + "/";
+  it = directories_.lower_bound(prefix);
+  while (it != directories_.end() &&
+         it->first.compare(0, prefix.size(), prefix) == 0)
+    erase(it++);
+}
+
+}  // namespace cloudstorage
@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * PathCache.h : PathCache headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IItem.h"
+
+namespace cloudstorage {
+
+/**
+ * Remembers directory listings done while resolving paths, so that paths
+ * sharing ancestors don't list them again. Listings are keyed by directory's
+ * path and index children by name; they're dropped after ttl or when the
+ * provider changes them with its own create, move, rename or delete request.
+ */
+class PathCache {
+ public:
+  using Pointer = std::shared_ptr<PathCache>;
+
+  struct Config {
+    Config();
+
+    /**
+     * Reads path_cache_ttl and path_cache_size hints.
+     */
+    static Config fromHints(
+        const std::unordered_map<std::string, std::string>&);
+
+    /**
+     * How long listings are used, 0 disables the cache.
+     */
+    std::chrono::milliseconds ttl_;
+
+    /**
+     * Limit of cached listings, oldest are dropped first.
+     */
+    uint32_t max_directories_;
+  };
+
+  struct Statistics {
+    uint64_t hits_;
+    uint64_t misses_;
+    uint32_t directories_;
+  };
+
+  PathCache(Config = Config());
+
+  /**
+   * Looks up name in cached listing of directory.
+   *
+   * @param path path of directory, empty for root
+   * @param found set to directory's child called name or to null if there is
+   * no such child
+   * @return whether listing of the directory was cached
+   */
+  bool lookup(const std::string& path, const IItem& directory,
+              const std::string& name, IItem::Pointer& found);
+
+  /**
+   * Remembers listing of directory at path.
+   */
+  void add(const std::string& path, const IItem& directory,
+           const std::vector<IItem::Pointer>& children);
+
+  /**
+   * Forgets listings of item, its descendants and directories containing it;
+   * called once item was deleted, moved or renamed.
+   */
+  void remove(const IItem& item);
+
+  /**
+   * Forgets listing of directory; called once an item was created in it.
+   */
+  void changed(const IItem& directory);
+
+  Statistics statistics();
+
+ private:
+  struct Directory {
+    std::string id_;
+    std::chrono::steady_clock::time_point listed_;
+    std::unordered_map<std::string, IItem::Pointer> children_;
+  };
+
+  using DirectoryMap = std::map<std::string, Directory>;
+
+  void erase(DirectoryMap::iterator);
+  void eraseTree(const std::string& path);
+
+  Config config_;
+  std::mutex mutex_;
+  DirectoryMap directories_;
+
+  /**
+   * Paths of children of cached directories, by item id.
+   */
+  std::unordered_multimap<std::string, std::string> paths_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // PATHCACHE_H
@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * Timer.cpp : Timer implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "Timer.h"
+
+#include <algorithm>
+
+namespace cloudstorage {
+
+namespace {
+
+bool later(const std::pair<std::chrono::steady_clock::time_point,
+                           Timer::Task::Pointer>& e1,
+           const std::pair<std::chrono::steady_clock::time_point,
+                           Timer::Task::Pointer>& e2) {
+  return e1.first > e2.first;
+}
+
+}  // namespace
+
+Timer::Task::Task(Callback callback)
+    : callback_(std::move(callback)), done_() {}
+
+void Timer::Task::finish() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return done_; });
+}
+
+void Timer::Task::cancel() { run(); }
+
+void Timer::Task::run() {
+  Callback callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!callback_) return;
+    callback = std::move(callback_);
+    callback_ = nullptr;
+  }
+  callback();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  finished_.notify_all();
+}
+
+Timer::Timer() : state_(std::make_shared<State>()), thread_(work, state_) {}
+
+Timer::~Timer() {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex_);
+    state_->done_ = true;
+  }
+  state_->changed_.notify_one();
+  if (thread_.get_id() == std::this_thread::get_id())
+    thread_.detach();
+  else
+    thread_.join();
+}
+
+Timer::Task::Pointer Timer::schedule(std::chrono::milliseconds delay,
+                                     Callback callback) {
+  auto task = std::make_shared<Task>(std::move(callback));
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex_);
+    state_->tasks_.push_back({std::chrono::steady_clock::now() + delay, task});
+    std::push_heap(state_->tasks_.begin(), state_->tasks_.end(), later);
+  }
+  state_->changed_.notify_one();
+  return task;
+}
+
+void Timer::work(std::shared_ptr<State> state) {
+  std::unique_lock<std::mutex> lock(state->mutex_);
+  auto& tasks = state->tasks_;
+  while (!state->done_) {
+    if (tasks.empty()) {
+      state->changed_.wait(lock);
+    } else if (tasks.front().first > std::chrono::steady_clock::now()) {
+      state->changed_.wait_until(lock, tasks.front().first);
+    } else {
+      std::pop_heap(tasks.begin(), tasks.end(), later);
+      auto task = tasks.back().second;
+      tasks.pop_back();
+      lock.unlock();
+      task->run();
+      lock.lock();
+    }
+  }
+  auto remaining = std::move(tasks);
+  lock.unlock();
+  for (auto&& t : remaining) t.second->run();
+}
+
+}  // namespace cloudstorage
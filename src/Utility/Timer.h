@@ -0,0 +1,99 @@
+/*****************************************************************************
+ * Timer.h : Timer headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "IRequest.h"
+
+namespace cloudstorage {
+
+/**
+ * Runs callbacks after given delay on its own thread.
+ */
+class Timer {
+ public:
+  using Pointer = std::unique_ptr<Timer>;
+  using Callback = std::function<void()>;
+
+  /**
+   * Scheduled callback; cancelling it runs the callback right away on the
+   * calling thread, finishing it waits until the callback was run.
+   */
+  class Task : public IGenericRequest {
+   public:
+    using Pointer = std::shared_ptr<Task>;
+
+    Task(Callback);
+
+    void finish() override;
+    void cancel() override;
+
+    /**
+     * Runs the callback unless it was already run.
+     */
+    void run();
+
+   private:
+    Callback callback_;
+    bool done_;
+    std::mutex mutex_;
+    std::condition_variable finished_;
+  };
+
+  Timer();
+  ~Timer();
+
+  Task::Pointer schedule(std::chrono::milliseconds delay, Callback);
+
+ private:
+  using Entry = std::pair<std::chrono::steady_clock::time_point, Task::Pointer>;
+
+  /**
+   * Shared with the thread, so that the timer can be destroyed by one of its
+   * own callbacks.
+   */
+  struct State {
+    bool done_;
+    std::vector<Entry> tasks_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+  };
+
+  static void work(std::shared_ptr<State>);
+
+  std::shared_ptr<State> state_;
+  std::thread thread_;
+};
+
+}  // namespace cloudstorage
+
+#endif  // TIMER_H
@@ -28,9 +28,9 @@
 
 #include <json/json.h>
 #include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <cstring>
-#include <iomanip>
 #include <sstream>
 #include <unordered_map>
 
@@ -105,10 +105,28 @@ Range parse_range(const std::string& r) {
 std::string range_to_string(Range r) {
   std::stringstream stream;
   stream << "bytes=" << r.start_ << "-";
-  if (r.size_ != Range::Full) stream << r.size_ - r.start_ + 1;
+  if (r.size_ != Range::Full) stream << r.start_ + r.size_ - 1;
   return stream.str();
 }
 
+std::string to_base64(const std::string& data) {
+  const char* alphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string result;
+  result.reserve((data.size() + 2) / 3 * 4);
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t value = static_cast<unsigned char>(data[i]) << 16;
+    if (i + 1 < data.size())
+      value |= static_cast<unsigned char>(data[i + 1]) << 8;
+    if (i + 2 < data.size()) value |= static_cast<unsigned char>(data[i + 2]);
+    result += alphabet[(value >> 18) & 63];
+    result += alphabet[(value >> 12) & 63];
+    result += i + 1 < data.size() ? alphabet[(value >> 6) & 63] : '=';
+    result += i + 2 < data.size() ? alphabet[value & 63] : '=';
+  }
+  return result;
+}
+
 std::string address(const std::string& url, uint16_t port) {
   const auto https = "https://";
   const auto http = "http://";
@@ -155,21 +173,20 @@ std::string Url::unescape(const std::string& str) {
 }
 
 std::string Url::escape(const std::string& value) {
-  std::ostringstream escaped;
-  escaped << std::setfill('0');
-  escaped << std::hex;
-
-  for (std::string::const_iterator i = value.begin(); i != value.end(); i++) {
-    std::string::value_type c = *i;
-    if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-      escaped << c;
-      continue;
+  const char* hex = "0123456789ABCDEF";
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ||
+        c == '.' || c == '~') {
+      escaped += c;
+    } else {
+      escaped += '%';
+      escaped += hex[static_cast<unsigned char>(c) >> 4];
+      escaped += hex[static_cast<unsigned char>(c) & 15];
     }
-    escaped << std::uppercase;
-    escaped << '%' << std::setw(2) << int(static_cast<unsigned char>(c));
-    escaped << std::nouppercase;
   }
-  return escaped.str();
+  return escaped;
 }
 
 std::string Url::escapeHeader(const std::string& header) {
@@ -51,6 +51,7 @@ Range parse_range(const std::string& str);
 std::string range_to_string(Range);
 std::string address(const std::string& url, uint16_t port);
 std::string to_mime_type(const std::string& extension);
+std::string to_base64(const std::string& data);
 
 class Url {
  public:
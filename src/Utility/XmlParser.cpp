@@ -0,0 +1,268 @@
+/*****************************************************************************
+ * XmlParser.cpp : XmlParser implementation
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "XmlParser.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+const size_t READ_SIZE = 16 * 1024;
+
+namespace cloudstorage {
+namespace util {
+
+namespace {
+
+bool isWhitespace(const std::string& str) {
+  return str.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+bool isPrefix(const std::string& prefix, const char* str) {
+  return std::strncmp(prefix.c_str(), str, prefix.size()) == 0;
+}
+
+void appendUtf8(std::string& str, unsigned long code) {
+  if (code < 0x80) {
+    str += static_cast<char>(code);
+  } else if (code < 0x800) {
+    str += static_cast<char>(0xC0 | (code >> 6));
+    str += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    str += static_cast<char>(0xE0 | (code >> 12));
+    str += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    str += static_cast<char>(0xF0 | (code >> 18));
+    str += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    str += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+void appendDecoded(std::string& result, const std::string& text) {
+  size_t position = 0;
+  while (position < text.size()) {
+    auto ampersand = text.find('&', position);
+    result.append(text, position, ampersand - position);
+    if (ampersand == std::string::npos) return;
+    auto semicolon = text.find(';', ampersand);
+    if (semicolon == std::string::npos) {
+      result.append(text, ampersand, std::string::npos);
+      return;
+    }
+    auto entity = text.substr(ampersand + 1, semicolon - ampersand - 1);
+    if (entity == "lt")
+      result += '<';
+    else if (entity == "gt")
+      result += '>';
+    else if (entity == "amp")
+      result += '&';
+    else if (entity == "quot")
+      result += '"';
+    else if (entity == "apos")
+      result += '\'';
+    else if (entity.size() > 1 && entity[0] == '#') {
+      bool hex = entity[1] == 'x' || entity[1] == 'X';
+      appendUtf8(result,
+                 std::strtoul(entity.c_str() + (hex ? 2 : 1), nullptr,
+                              hex ? 16 : 10));
+    } else {
+      result.append(text, ampersand, semicolon - ampersand + 1);
+    }
+    position = semicolon + 1;
+  }
+}
+
+}  // namespace
+
+XmlParser::XmlParser(ElementEnd callback)
+    : callback_(callback),
+      state_(State::Text),
+      quote_(),
+      pending_(),
+      root_done_() {}
+
+void XmlParser::write(const char* data, size_t length) {
+  const char* end = data + length;
+  while (data < end) {
+    char c = *data;
+    switch (state_) {
+      case State::Text: {
+        auto next =
+            static_cast<const char*>(std::memchr(data, '<', end - data));
+        if (!next) {
+          raw_text_.append(data, end);
+          return;
+        }
+        raw_text_.append(data, next);
+        flushText();
+        if (state_ == State::Failed) return;
+        markup_.clear();
+        state_ = State::Markup;
+        data = next;
+        break;
+      }
+      case State::Markup:
+        markup(c);
+        break;
+      case State::Tag:
+        if (quote_) {
+          if (c == quote_) quote_ = 0;
+          markup_ += c;
+        } else if (c == '"' || c == '\'') {
+          quote_ = c;
+          markup_ += c;
+        } else if (c == '>') {
+          tag();
+        } else {
+          markup_ += c;
+        }
+        break;
+      case State::Comment:
+        if (c == '>' && pending_ >= 2)
+          state_ = State::Text;
+        else
+          pending_ = c == '-' ? pending_ + 1 : 0;
+        break;
+      case State::CData:
+        if (c == ']') {
+          pending_++;
+        } else if (c == '>' && pending_ >= 2) {
+          text_.back().append(pending_ - 2, ']');
+          pending_ = 0;
+          state_ = State::Text;
+        } else {
+          text_.back().append(pending_, ']');
+          text_.back() += c;
+          pending_ = 0;
+        }
+        break;
+      case State::Instruction:
+        if (c == '>' && pending_) state_ = State::Text;
+        pending_ = c == '?';
+        break;
+      case State::Declaration:
+        if (c == '[')
+          pending_++;
+        else if (c == ']')
+          pending_--;
+        else if (c == '>' && pending_ <= 0)
+          state_ = State::Text;
+        break;
+      case State::Failed:
+        return;
+    }
+    data++;
+  }
+}
+
+void XmlParser::write(std::istream& stream) {
+  char buffer[READ_SIZE];
+  while (state_ != State::Failed) {
+    auto read = stream.rdbuf()->sgetn(buffer, READ_SIZE);
+    if (read <= 0) break;
+    write(buffer, static_cast<size_t>(read));
+  }
+}
+
+bool XmlParser::finish() const {
+  return state_ == State::Text && root_done_ && path_.empty() &&
+         isWhitespace(raw_text_);
+}
+
+void XmlParser::markup(char c) {
+  markup_ += c;
+  if (markup_[0] == '?') {
+    state_ = State::Instruction;
+    pending_ = 0;
+  } else if (markup_[0] == '!') {
+    if (markup_ == "!--") {
+      state_ = State::Comment;
+      pending_ = 0;
+    } else if (markup_ == "![CDATA[") {
+      if (path_.empty()) return fail();
+      state_ = State::CData;
+      pending_ = 0;
+    } else if (!isPrefix(markup_, "!--") && !isPrefix(markup_, "![CDATA[")) {
+      state_ = State::Declaration;
+      pending_ = std::count(markup_.begin(), markup_.end(), '[');
+      if (c == '>') state_ = State::Text;
+    }
+  } else {
+    state_ = State::Tag;
+    quote_ = 0;
+    if (c == '>') {
+      markup_.pop_back();
+      tag();
+    } else if (c == '"' || c == '\'') {
+      quote_ = c;
+    }
+  }
+}
+
+void XmlParser::tag() {
+  state_ = State::Text;
+  if (markup_.empty()) return fail();
+  bool closing = markup_[0] == '/';
+  bool empty = !closing && markup_.back() == '/';
+  if (closing) {
+    auto last = markup_.find_last_not_of(" \t\r\n");
+    if (path_.empty() || markup_.compare(1, last, path_.back()) != 0)
+      return fail();
+  } else {
+    auto name = markup_.substr(0, markup_.find_first_of(" \t\r\n/"));
+    if (name.empty() || (path_.empty() && root_done_)) return fail();
+    path_.push_back(std::move(name));
+    text_.emplace_back();
+  }
+  if (closing || empty) {
+    try {
+      callback_(path_, text_.back());
+    } catch (...) {
+      return fail();
+    }
+    path_.pop_back();
+    text_.pop_back();
+    if (path_.empty()) root_done_ = true;
+  }
+}
+
+void XmlParser::flushText() {
+  if (raw_text_.empty()) return;
+  if (path_.empty()) {
+    if (!isWhitespace(raw_text_)) fail();
+  } else {
+    appendDecoded(text_.back(), raw_text_);
+  }
+  raw_text_.clear();
+}
+
+void XmlParser::fail() {
+  state_ = State::Failed;
+  path_.clear();
+  text_.clear();
+}
+
+}  // namespace util
+}  // namespace cloudstorage
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * XmlParser.h : XmlParser headers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef XMLPARSER_H
+#define XMLPARSER_H
+
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace cloudstorage {
+namespace util {
+
+/**
+ * Push parser for xml responses of cloud providers. Document may be split at
+ * any byte between calls to write, so it can be parsed while it's being
+ * downloaded, without keeping the whole response or its tree in memory.
+ * Attributes, comments, processing instructions and doctype are skipped;
+ * character references and CDATA sections are decoded.
+ */
+class XmlParser {
+ public:
+  /**
+   * Called when element ends.
+   *
+   * @param path names of the element's ancestors, starting with the root,
+   * followed by element's name
+   * @param text element's own character data
+   */
+  using ElementEnd = std::function<void(const std::vector<std::string>& path,
+                                        const std::string& text)>;
+
+  XmlParser(ElementEnd);
+
+  /**
+   * Parses next chunk of the document. Doesn't throw; an exception thrown by
+   * the callback marks the document as invalid instead, so it's safe to call
+   * from http engine's callbacks.
+   */
+  void write(const char* data, size_t length);
+
+  /**
+   * Parses whole stream.
+   */
+  void write(std::istream&);
+
+  /**
+   * @return whether the document was complete and well formed
+   */
+  bool finish() const;
+
+ private:
+  enum class State {
+    Text,
+    Markup,
+    Tag,
+    Comment,
+    CData,
+    Instruction,
+    Declaration,
+    Failed
+  };
+
+  void markup(char);
+  void tag();
+  void flushText();
+  void fail();
+
+  ElementEnd callback_;
+  State state_;
+  std::vector<std::string> path_;
+  std::vector<std::string> text_;
+  std::string raw_text_;
+  std::string markup_;
+  char quote_;
+  int pending_;
+  bool root_done_;
+};
+
+}  // namespace util
+}  // namespace cloudstorage
+
+#endif  // XMLPARSER_H
@@ -0,0 +1,220 @@
+/*****************************************************************************
+ * listing_benchmark.cpp : throughput of directory listing parsers
+ *
+ *****************************************************************************
+ * Copyright (C) 2016-2016 VideoLAN
+ *
+ * Authors: Paweł Wegner <pawel.wegner95@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CloudProvider/AmazonDrive.h"
+#include "CloudProvider/Box.h"
+#include "CloudProvider/Dropbox.h"
+#include "CloudProvider/GoogleDrive.h"
+#include "CloudProvider/OneDrive.h"
+#include "CloudProvider/YandexDisk.h"
+#include "Utility/Item.h"
+#include "Utility/JsonView.h"
+
+namespace {
+
+const int PAGE_SIZE = 1000;
+
+// size of chunks the page is written in, like http engine's buffer
+const size_t CHUNK_SIZE = 16 * 1024;
+
+struct Page {
+  std::string name_;
+  std::shared_ptr<cloudstorage::CloudProvider> provider_;
+  std::string content_;
+};
+
+std::string quote(const std::string& str) { return "\"" + str + "\""; }
+
+std::string page(const std::string& prefix,
+                 std::function<std::string(int)> entry,
+                 const std::string& suffix) {
+  std::string result = prefix;
+  for (int i = 0; i < PAGE_SIZE; i++) {
+    if (i != 0) result += ",";
+    result += entry(i);
+  }
+  return result + suffix;
+}
+
+std::string googleDriveEntry(int i) {
+  return "{\"kind\":\"drive#file\",\"id\":" +
+         quote("1AbCdEfGhIjKlMnOpQrStUv" + std::to_string(i)) +
+         ",\"name\":" + quote("Photo \\u00e9 " + std::to_string(i) + ".jpg") +
+         ",\"mimeType\":" +
+         quote(i % 5 ? "image/jpeg" : "application/vnd.google-apps.folder") +
+         ",\"trashed\":false,\"parents\":[\"0AIdParentFolder\"],\"size\":" +
+         quote(std::to_string(i * 1234)) +
+         ",\"thumbnailLink\":\"https://lh3.googleusercontent.com/"
+         "abcdefghijklmnopqrstuvwxyz0123456789=s220\",\"iconLink\":\""
+         "https://drive-thirdparty.googleusercontent.com/16/type/image/jpeg"
+         "\",\"modifiedTime\":\"2017-01-01T10:00:00.000Z\"}";
+}
+
+std::string oneDriveEntry(int i) {
+  return "{\"createdDateTime\":\"2017-01-01T10:00:00Z\",\"eTag\":"
+         "\"\\\"{ABC},1\\\"\",\"id\":" +
+         quote("01BYE5RZ" + std::to_string(i)) +
+         ",\"name\":" + quote("file" + std::to_string(i) + ".mp4") +
+         ",\"size\":" + std::to_string(i * 77777) +
+         ",\"@content.downloadUrl\":\"https://public.bn1304.livefilestore.com/"
+         "y4mABCDEFGHIJKLMNOPQRSTUVWXYZ\",\"parentReference\":{\"driveId\":"
+         "\"b!abc\",\"id\":\"01BYE5RZROOT\",\"path\":\"/drive/root:\"}," +
+         (i % 4 ? "\"file\":{\"mimeType\":\"video/mp4\",\"hashes\":"
+                  "{\"quickXorHash\":\"abc=\"}},\"video\":{\"duration\":1000,"
+                  "\"height\":720,\"width\":1280}"
+                : "\"folder\":{\"childCount\":3}") +
+         "}";
+}
+
+std::string dropboxEntry(int i) {
+  return "{\".tag\":" + quote(i % 6 ? "file" : "folder") +
+         ",\"name\":" + quote("doc" + std::to_string(i) + ".pdf") +
+         ",\"id\":" + quote("id:a4ayc_80_OEAAAAAAAAAX" + std::to_string(i)) +
+         ",\"client_modified\":\"2015-05-12T15:50:38Z\",\"server_modified\":"
+         "\"2015-05-12T15:50:38Z\",\"rev\":\"a1c10ce0dd78\",\"size\":" +
+         std::to_string(i * 4321) + ",\"path_lower\":" +
+         quote("/homework/doc" + std::to_string(i) + ".pdf") +
+         ",\"path_display\":" +
+         quote("/Homework/doc" + std::to_string(i) + ".pdf") +
+         ",\"media_info\":{\".tag\":\"metadata\",\"metadata\":{\".tag\":"
+         "\"photo\",\"dimensions\":{\"height\":1500,\"width\":1500}}},"
+         "\"content_hash\":\"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934c"
+         "a495991b7852b855\"}";
+}
+
+std::string boxEntry(int i) {
+  return "{\"type\":" + quote(i % 7 ? "file" : "folder") +
+         ",\"id\":" + quote(std::to_string(5000948880 + i)) +
+         ",\"sequence_id\":\"3\",\"etag\":\"3\",\"sha1\":"
+         "\"134b65991ed521fcfe4724b7d814ab8ded5185dc\",\"name\":" +
+         quote("tigers" + std::to_string(i) + ".jpeg") +
+         ",\"size\":" + std::to_string(i * 999) + "}";
+}
+
+std::string amazonDriveEntry(int i) {
+  return "{\"eTagResponse\":\"AbCdEf\",\"id\":" +
+         quote("m7yQ9-sZQnmz8uLZJd4d" + std::to_string(i)) +
+         ",\"name\":" + quote("img" + std::to_string(i) + ".png") +
+         ",\"kind\":" + quote(i % 8 ? "FILE" : "FOLDER") +
+         ",\"isRoot\":false,\"parents\":[\"xmZQnmz8uLZJd4d\"],\"status\":"
+         "\"AVAILABLE\",\"tempLink\":\"https://content-na.drive.amazonaws.com/"
+         "cdproxy/templink/abcdef\",\"contentProperties\":{\"size\":" +
+         std::to_string(i * 555) +
+         ",\"md5\":\"abc\",\"contentType\":\"image/png\",\"extension\":\"png\","
+         "\"image\":{\"width\":100,\"height\":100}},\"assets\":[]}";
+}
+
+std::string yandexDiskEntry(int i) {
+  return "{\"name\":" + quote("music" + std::to_string(i) + ".mp3") +
+         ",\"preview\":\"https://downloader.disk.yandex.ru/preview/abcdef\","
+         "\"created\":\"2014-04-22T14:57:13+04:00\",\"modified\":"
+         "\"2014-04-22T14:57:14+04:00\",\"path\":" +
+         quote("disk:/foo/music" + std::to_string(i) + ".mp3") +
+         ",\"md5\":\"4334dc6379c8f95ddf11b9508cfea271\",\"type\":" +
+         quote(i % 9 ? "file" : "dir") +
+         ",\"mime_type\":\"audio/mpeg\",\"size\":" + std::to_string(i * 333) +
+         "}";
+}
+
+std::vector<Page> pages() {
+  return {
+      {"googledrive", std::make_shared<cloudstorage::GoogleDrive>(),
+       page("{\"kind\":\"drive#fileList\",\"incompleteSearch\":false,"
+            "\"files\":[",
+            googleDriveEntry, "],\"nextPageToken\":\"~!!~AI9FV7Q\"}")},
+      {"onedrive", std::make_shared<cloudstorage::OneDrive>(),
+       page("{\"@odata.context\":\"https://graph.microsoft.com/v1.0/"
+            "$metadata\",\"value\":[",
+            oneDriveEntry,
+            "],\"@odata.nextLink\":\"https://graph.microsoft.com/v1.0/me/"
+            "drive/root/children?$skiptoken=abc\"}")},
+      {"dropbox", std::make_shared<cloudstorage::Dropbox>(),
+       page("{\"entries\":[", dropboxEntry,
+            "],\"cursor\":\"ZtkX9_EHj3x7PMkVuFIhwKYXEpwpLwyxp9vMKomUhllil9q7e"
+            "WiAu\",\"has_more\":true}")},
+      {"box", std::make_shared<cloudstorage::Box>(),
+       page("{\"total_count\":5000,\"entries\":[", boxEntry,
+            "],\"offset\":0,\"limit\":1000,\"order\":[{\"by\":\"type\","
+            "\"direction\":\"ASC\"}]}")},
+      {"amazond", std::make_shared<cloudstorage::AmazonDrive>(),
+       page("{\"count\":5000,\"data\":[", amazonDriveEntry,
+            "],\"nextToken\":\"kgkbpodpt6\"}")},
+      {"yandex", std::make_shared<cloudstorage::YandexDisk>(),
+       page("{\"_embedded\":{\"sort\":\"\",\"path\":\"disk:/foo\",\"items\":[",
+            yandexDiskEntry,
+            "],\"limit\":1000,\"offset\":0,\"total\":3000},\"name\":\"foo\","
+            "\"type\":\"dir\",\"path\":\"disk:/foo\"}")}};
+}
+
+/**
+ * @return count of items found in the page, 0 if it wasn't parsed
+ */
+size_t parse(const Page& page) {
+  cloudstorage::Item directory("directory", "directory", 0,
+                               cloudstorage::IItem::FileType::Directory);
+  size_t count = 0;
+  auto parser = page.provider_->listDirectoryParser(
+      directory, [&count](cloudstorage::IItem::Pointer) { count++; });
+  if (!parser) return 0;
+  for (size_t offset = 0; offset < page.content_.size();
+       offset += CHUNK_SIZE)
+    parser->write(page.content_.data() + offset,
+                  std::min(CHUNK_SIZE, page.content_.size() - offset));
+  std::string next_page_token;
+  return parser->finish(next_page_token) ? count : 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int repeat = argc >= 2 ? std::atoi(argv[1]) : 30;
+  if (repeat <= 0) {
+    std::cout << "usage: " << argv[0] << " [repeat]\n";
+    return 1;
+  }
+  std::cout << "json backend: " << cloudstorage::util::JsonDocument::backend()
+            << "\n";
+  for (const auto& page : pages()) {
+    size_t items = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++) items += parse(page);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (items != static_cast<size_t>(repeat) * PAGE_SIZE) {
+      std::cout << page.name_ << ": page wasn't parsed\n";
+      return 1;
+    }
+    std::cout << page.name_ << ": " << static_cast<uint64_t>(items / seconds)
+              << " items/s\n";
+  }
+  return 0;
+}
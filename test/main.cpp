@@ -52,21 +52,29 @@ class Callback : public cloudstorage::ICloudProvider::IAuthCallback {
   std::string drive_file_;
 };
 
-void traverse_drive(cloudstorage::ICloudProvider& drive,
-                    cloudstorage::IItem::Pointer f, std::string path) {
-  std::cout << path << "\n";
-  if (f->type() != cloudstorage::IItem::FileType::Directory) return;
-  auto lst = drive.listDirectoryAsync(f)->result();
-  if (lst.left()) {
-    std::cout << "error " << lst.left()->code_ << "\n";
-    return;
+class WalkCallback : public cloudstorage::IWalkTreeCallback {
+ public:
+  bool receivedItem(cloudstorage::IItem::Pointer item, const std::string& path,
+                    uint32_t) override {
+    std::cout << path
+              << (item->type() == cloudstorage::IItem::FileType::Directory
+                      ? "/"
+                      : "")
+              << "\n";
+    return true;
   }
-  for (cloudstorage::IItem::Pointer& t : *lst.right()) {
-    traverse_drive(
-        drive, std::move(t),
-        path + t->filename() +
-            (t->type() == cloudstorage::IItem::FileType::Directory ? "/" : ""));
+
+  void progress(uint64_t, uint64_t, uint64_t) override {}
+
+  void done(cloudstorage::EitherError<void> e) override {
+    if (e.left()) std::cout << "error " << e.left()->code_ << "\n";
   }
+};
+
+void traverse_drive(cloudstorage::ICloudProvider& drive,
+                    cloudstorage::IItem::Pointer f) {
+  std::cout << "/\n";
+  drive.walkTreeAsync(f, std::make_shared<WalkCallback>())->result();
 }
 
 int main(int argc, char** argv) {
@@ -91,7 +99,7 @@ int main(int argc, char** argv) {
     std::cout << "Invalid drive backend.\n";
     return 1;
   }
-  traverse_drive(*drive, drive->rootDirectory(), "/");
+  traverse_drive(*drive, drive->rootDirectory());
 
   return 0;
 }